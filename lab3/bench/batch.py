@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Times ParaParaCL compiling a batch of small programs with 1 to N jobs.
+
+Each program is a short loop nest; the batch is passed through a response
+file and compiled to object files, so the time covers the whole pipeline.
+
+Usage: batch.py <ParaParaCL> [files [jobs ...]]
+"""
+
+import os
+import pathlib
+import subprocess
+import sys
+import tempfile
+import time
+
+DEFAULT_FILES = 2000
+
+
+def generate(seed: int) -> str:
+    lines = (
+        f"n = {seed % 50 + 10};",
+        "i = 0;",
+        "sum = 0;",
+        "while (i < n) {",
+        "  j = 0;",
+        "  while (j < i) {",
+        f"    sum = (sum + i * j + {seed}) % 1000;",
+        "    j = j + 1;",
+        "  }",
+        "  i = i + 1;",
+        "}",
+        "return sum;",
+    )
+    return "\n".join(lines) + "\n"
+
+
+def measure(
+    compiler: str, response: pathlib.Path, jobs: int, repeat: int = 3
+) -> float:
+    best = float("inf")
+    for _ in range(repeat):
+        start = time.perf_counter()
+        subprocess.run(
+            [compiler, "-O2", "--emit=obj", f"--jobs={jobs}", f"@{response}"],
+            check=True,
+        )
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+def main() -> int:
+    compiler = sys.argv[1]
+    files = int(sys.argv[2]) if len(sys.argv) > 2 else DEFAULT_FILES
+    cores = os.cpu_count() or 1
+    jobs_list = [int(arg) for arg in sys.argv[3:]] or sorted(
+        {job for job in (1, 2, 4, 8, 16) if job < cores} | {cores}
+    )
+    with tempfile.TemporaryDirectory() as directory:
+        sources = []
+        for seed in range(files):
+            source = pathlib.Path(directory) / f"program-{seed}.dat"
+            source.write_text(generate(seed), encoding="utf-8")
+            sources.append(str(source))
+        response = pathlib.Path(directory) / "inputs.rsp"
+        response.write_text("\n".join(sources), encoding="utf-8")
+
+        print("jobs,seconds,speedup")
+        baseline = None
+        for jobs in jobs_list:
+            seconds = measure(compiler, response, jobs)
+            baseline = baseline or seconds
+            print(f"{jobs},{seconds:.3f},{baseline / seconds:.2f}", flush=True)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,532 @@
+// Measures how the phases of the compiler scale with the size of the input.
+//
+// Every workload is a synthetic program generated in memory and compiled by
+// the real Driver and CodeGenerator in a child process of its own, so that
+// the peak resident set size belongs to that workload alone. Wall time and
+// heap allocations are recorded per phase, and the results are written as
+// JSON that a later run can be compared against with --baseline.
+//
+// Usage: ParaParaCL-bench [--scale=<factor>] [--repeat=<n>] [--filter=<text>]
+//                         [-O<n>] [--emit=ll|bc|asm|obj] [--output=<file>]
+//                         [--baseline=<file>] [--threshold=<percent>]
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// clang-format off
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+// clang-format on
+
+#include "code_generator.h"
+#include "compiler.h"
+#include "driver.h"
+#include "options.h"
+#include "session.h"
+
+namespace {
+
+std::atomic<std::uint64_t> allocation_count{0};
+std::atomic<std::uint64_t> allocated_bytes{0};
+
+void* Allocate(const std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (auto* const pointer = std::malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw std::bad_alloc{};
+}
+
+void* AllocateAligned(const std::size_t size, const std::align_val_t align) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  const auto alignment = static_cast<std::size_t>(align);
+  // aligned_alloc requires the size to be a multiple of the alignment.
+  const auto rounded = (std::max(size, std::size_t{1}) + alignment - 1) /
+                       alignment * alignment;
+  if (auto* const pointer = std::aligned_alloc(alignment, rounded)) {
+    return pointer;
+  }
+  throw std::bad_alloc{};
+}
+
+}  // namespace
+
+// Counting replacements of the global allocation functions. The nothrow and
+// array forms of the standard library forward to these.
+void* operator new(const std::size_t size) { return Allocate(size); }
+void* operator new[](const std::size_t size) { return Allocate(size); }
+void* operator new(const std::size_t size, const std::align_val_t align) {
+  return AllocateAligned(size, align);
+}
+void* operator new[](const std::size_t size, const std::align_val_t align) {
+  return AllocateAligned(size, align);
+}
+void operator delete(void* const pointer) noexcept { std::free(pointer); }
+void operator delete[](void* const pointer) noexcept { std::free(pointer); }
+void operator delete(void* const pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* const pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+void operator delete(void* const pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* const pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete(void* const pointer, std::size_t,
+                     std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* const pointer, std::size_t,
+                       std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+namespace {
+
+constexpr std::string_view kPhases[] = {"parse", "analyze", "codegen",
+                                        "optimize", "emit"};
+
+struct Workload final {
+  std::string_view name;
+  std::size_t size;
+  std::string (*generate)(std::size_t size);
+};
+
+// `size` statements assigning to a rotating set of variables. They're in a
+// loop, so that the IR builder can't fold them to constants.
+std::string GenerateAssignments(const std::size_t size) {
+  constexpr auto kVariables = std::size_t{64};
+  auto source = std::string{};
+  source.reserve(size * 24);
+  for (auto i = std::size_t{0}; i < kVariables; ++i) {
+    source += "v" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+  }
+  source += "i = 0;\nwhile (i < 2) {\n";
+  for (auto i = std::size_t{0}; i < size; ++i) {
+    source += "v" + std::to_string(i % kVariables) + " = v" +
+              std::to_string((i * 7 + 3) % kVariables) + " + " +
+              std::to_string(i % 1000) + ";\n";
+  }
+  source += "i = i + 1;\n}\nreturn v0;\n";
+  return source;
+}
+
+// `size` levels alternating between `if` and `while`, each declaring a
+// variable of its own.
+std::string GenerateNesting(const std::size_t size) {
+  auto source = std::string{"x = 0;\n"};
+  for (auto level = std::size_t{0}; level < size; ++level) {
+    const auto name = "n" + std::to_string(level);
+    source += name + " = x + " + std::to_string(level) + ";\n";
+    source += level % 2 == 0 ? "if (" + name + " > 1) {\n"
+                             : "while (x < " + name + ") {\n";
+    source += "x = x + 1;\n";
+  }
+  for (auto level = size; level-- > 0;) {
+    source += level % 2 == 0 ? "} else {\n}\n" : "}\n";
+  }
+  source += "return x;\n";
+  return source;
+}
+
+// `size` statements in a loop, each a left-leaning chain of `size` operands.
+std::string GenerateExpressions(const std::size_t size) {
+  constexpr std::string_view kOperators[] = {" + ", " * ", " - ", " % "};
+  auto source = std::string{"a = 1;\nb = 2;\ni = 0;\nwhile (i < 2) {\n"};
+  for (auto i = std::size_t{0}; i < size; ++i) {
+    source += i % 2 == 0 ? "a = b" : "b = a";
+    for (auto j = std::size_t{1}; j < size; ++j) {
+      source += kOperators[(i + j) % std::size(kOperators)];
+      source += j % 3 == 0 ? (i % 2 == 0 ? "a" : "b") : std::to_string(j + 1);
+    }
+    source += ";\n";
+  }
+  source += "i = i + 1;\n}\nreturn a + b;\n";
+  return source;
+}
+
+constexpr Workload kWorkloads[] = {
+    {"assignments", 1'000'000, GenerateAssignments},
+    {"nesting", 10'000, GenerateNesting},
+    {"expressions", 1'000, GenerateExpressions},
+};
+
+struct BenchOptions final {
+  double scale = 1.0;
+  unsigned repeat = 3;
+  std::string filter;
+  std::string pipeline;
+  frontend::EmitKind emit_kind = frontend::EmitKind::kIr;
+  // The argument of --emit, under which the results record the kind.
+  std::string emit = "ll";
+  std::optional<std::string> output;
+  std::optional<std::string> baseline;
+  double threshold = 10.0;
+};
+
+std::optional<BenchOptions> ParseBenchOptions(const int argc,
+                                              char* const argv[]) {
+  auto options = BenchOptions{};
+  for (auto i = 1; i < argc; ++i) {
+    auto arg = llvm::StringRef{argv[i]};
+    if (arg.consume_front("--scale=")) {
+      if (arg.getAsDouble(options.scale) || options.scale <= 0) {
+        return std::nullopt;
+      }
+    } else if (arg.consume_front("--repeat=")) {
+      if (arg.getAsInteger(10, options.repeat) || options.repeat == 0) {
+        return std::nullopt;
+      }
+    } else if (arg.consume_front("--filter=")) {
+      options.filter = arg.str();
+    } else if (arg == "-O0") {
+      options.pipeline.clear();
+    } else if (arg == "-O1" || arg == "-O2" || arg == "-O3") {
+      options.pipeline = "default<" + arg.drop_front().str() + ">";
+    } else if (arg.consume_front("--emit=")) {
+      const auto kind = frontend::ParseEmitKind(arg);
+      if (!kind) {
+        return std::nullopt;
+      }
+      options.emit_kind = *kind;
+      options.emit = arg.str();
+    } else if (arg.consume_front("--output=")) {
+      options.output = arg.str();
+    } else if (arg.consume_front("--baseline=")) {
+      options.baseline = arg.str();
+    } else if (arg.consume_front("--threshold=")) {
+      if (arg.getAsDouble(options.threshold) || options.threshold < 0) {
+        return std::nullopt;
+      }
+    } else {
+      return std::nullopt;
+    }
+  }
+  return options;
+}
+
+struct PhaseResult final {
+  double seconds = 0;
+  std::uint64_t allocations = 0;
+  std::uint64_t allocated_bytes = 0;
+};
+
+// Times a phase and counts its allocations, keeping the fastest of the
+// repetitions; allocations don't vary between them.
+class PhaseRecorder final {
+ public:
+  explicit PhaseRecorder(std::vector<PhaseResult>& results)
+      : results_(results) {}
+
+  template <typename Function>
+  void Record(const std::size_t phase, Function&& function) {
+    const auto allocations = allocation_count.load();
+    const auto bytes = allocated_bytes.load();
+    const auto start = std::chrono::steady_clock::now();
+    std::forward<Function>(function)();
+    const auto seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+    auto& result = results_[phase];
+    if (!is_recorded_[phase] || seconds < result.seconds) {
+      result.seconds = seconds;
+    }
+    result.allocations = allocation_count.load() - allocations;
+    result.allocated_bytes = allocated_bytes.load() - bytes;
+    is_recorded_[phase] = true;
+  }
+
+ private:
+  std::vector<PhaseResult>& results_;
+  bool is_recorded_[std::size(kPhases)] = {};
+};
+
+// Compiles the workload `repeat` times and returns its results. Runs in the
+// child process.
+llvm::json::Object RunWorkload(const BenchOptions& options,
+                               const Workload& workload,
+                               const std::size_t size) {
+  const auto source = workload.generate(size);
+  auto session = frontend::Session{};
+
+  auto results = std::vector<PhaseResult>(std::size(kPhases));
+  auto recorder = PhaseRecorder{results};
+  for (auto i = 0U; i < options.repeat; ++i) {
+    auto driver = frontend::Driver{};
+    recorder.Record(0, [&] {
+      driver.ParseBuffer(source, std::string{workload.name});
+    });
+    recorder.Record(1, [&] { frontend::Analyze(driver); });
+
+    auto code_generator =
+        frontend::CodeGenerator{driver.get_symbols(), session};
+    recorder.Record(2,
+                    [&] { driver.get_program()->Accept(code_generator); });
+    recorder.Record(3, [&] {
+      if (!options.pipeline.empty()) {
+        code_generator.Optimize(options.pipeline);
+      }
+    });
+    recorder.Record(4, [&] {
+      auto stream = llvm::raw_null_ostream{};
+      code_generator.Emit(options.emit_kind, stream);
+    });
+  }
+
+  auto phases = llvm::json::Object{};
+  for (auto i = std::size_t{0}; i < std::size(kPhases); ++i) {
+    phases[llvm::StringRef{kPhases[i]}] = llvm::json::Object{
+        {"seconds", results[i].seconds},
+        {"allocations", static_cast<std::int64_t>(results[i].allocations)},
+        {"allocated_bytes",
+         static_cast<std::int64_t>(results[i].allocated_bytes)},
+    };
+  }
+
+  auto resource_usage = rusage{};
+  getrusage(RUSAGE_SELF, &resource_usage);
+  return llvm::json::Object{
+      {"name", std::string{workload.name}},
+      {"size", static_cast<std::int64_t>(size)},
+      {"source_bytes", static_cast<std::int64_t>(source.size())},
+      {"phases", std::move(phases)},
+      {"peak_rss_kib", static_cast<std::int64_t>(resource_usage.ru_maxrss)},
+  };
+}
+
+// Runs the workload in a child process and returns the JSON object it writes
+// to a pipe.
+llvm::json::Value RunInChild(const BenchOptions& options,
+                             const Workload& workload, const std::size_t size) {
+  int pipe_ends[2];
+  if (pipe(pipe_ends) != 0) {
+    throw std::runtime_error("Failed to create a pipe");
+  }
+
+  const auto pid = fork();
+  if (pid < 0) {
+    throw std::runtime_error("Failed to fork");
+  }
+  if (pid == 0) {
+    close(pipe_ends[0]);
+    auto status = 0;
+    try {
+      auto stream = llvm::raw_fd_ostream{pipe_ends[1], /*shouldClose=*/true};
+      stream << llvm::json::Value(RunWorkload(options, workload, size));
+    } catch (const std::exception& e) {
+      std::cerr << workload.name << ": " << e.what() << std::endl;
+      status = 1;
+    }
+    std::_Exit(status);
+  }
+
+  close(pipe_ends[1]);
+  auto output = std::string{};
+  char buffer[4096];
+  for (auto count = read(pipe_ends[0], buffer, sizeof(buffer)); count != 0;
+       count = read(pipe_ends[0], buffer, sizeof(buffer))) {
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    output.append(buffer, static_cast<std::size_t>(count));
+  }
+  close(pipe_ends[0]);
+
+  auto status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    throw std::runtime_error("Workload " + std::string{workload.name} +
+                             " failed");
+  }
+
+  auto value = llvm::json::parse(output);
+  if (!value) {
+    throw std::runtime_error("Workload " + std::string{workload.name} +
+                             " wrote malformed results: " +
+                             llvm::toString(value.takeError()));
+  }
+  return std::move(*value);
+}
+
+double GetNumber(const llvm::json::Object& object, const llvm::StringRef key) {
+  const auto number = object.getNumber(key);
+  return number ? *number : 0;
+}
+
+// Reports every measurement that grew by more than the threshold over the
+// baseline and returns whether there was none.
+bool CompareWithBaseline(const BenchOptions& options,
+                         const llvm::json::Array& benchmarks,
+                         const llvm::json::Value& baseline) {
+  const auto* const baseline_benchmarks =
+      baseline.getAsObject() != nullptr
+          ? baseline.getAsObject()->getArray("benchmarks")
+          : nullptr;
+  if (baseline_benchmarks == nullptr) {
+    throw std::runtime_error("Baseline has no benchmarks");
+  }
+  if (baseline.getAsObject()->getString("pipeline") !=
+      llvm::StringRef{options.pipeline}) {
+    throw std::runtime_error("Baseline was measured with another pipeline");
+  }
+  if (baseline.getAsObject()->getString("emit") !=
+      llvm::StringRef{options.emit}) {
+    throw std::runtime_error("Baseline was measured with another emit kind");
+  }
+
+  const auto find_baseline =
+      [&](const llvm::json::Object& benchmark) -> const llvm::json::Object* {
+    for (const auto& candidate : *baseline_benchmarks) {
+      const auto* const object = candidate.getAsObject();
+      if (object != nullptr &&
+          object->getString("name") == benchmark.getString("name") &&
+          object->getInteger("size") == benchmark.getInteger("size")) {
+        return object;
+      }
+    }
+    return nullptr;
+  };
+
+  auto is_within = true;
+  const auto compare = [&](const std::string& what, const double current,
+                           const double previous, std::string_view unit) {
+    const auto change = previous > 0 ? (current / previous - 1) * 100 : 0;
+    if (change > options.threshold) {
+      is_within = false;
+      std::cerr << what << ": " << current << unit << " vs " << previous
+                << unit << " (+" << change << "%)" << std::endl;
+    }
+  };
+
+  for (const auto& value : benchmarks) {
+    const auto& benchmark = *value.getAsObject();
+    const auto* const previous = find_baseline(benchmark);
+    if (previous == nullptr) {
+      continue;
+    }
+
+    const auto name = benchmark.getString("name")->str();
+    for (const auto phase : kPhases) {
+      const auto* const current_phase =
+          benchmark.getObject("phases")->getObject(llvm::StringRef{phase});
+      const auto* const previous_phases = previous->getObject("phases");
+      const auto* const previous_phase =
+          previous_phases != nullptr
+              ? previous_phases->getObject(llvm::StringRef{phase})
+              : nullptr;
+      if (previous_phase == nullptr) {
+        continue;
+      }
+
+      const auto prefix = name + " " + std::string{phase};
+      compare(prefix + " time", GetNumber(*current_phase, "seconds"),
+              GetNumber(*previous_phase, "seconds"), " s");
+      compare(prefix + " allocations",
+              GetNumber(*current_phase, "allocations"),
+              GetNumber(*previous_phase, "allocations"), "");
+    }
+    compare(name + " peak RSS", GetNumber(benchmark, "peak_rss_kib"),
+            GetNumber(*previous, "peak_rss_kib"), " KiB");
+  }
+  return is_within;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  const auto options = ParseBenchOptions(argc, argv);
+  if (!options) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--scale=<factor>] [--repeat=<n>] [--filter=<text>]"
+                 " [-O0|-O1|-O2|-O3] [--emit=ll|bc|asm|obj]"
+                 " [--output=<file>] [--baseline=<file>]"
+                 " [--threshold=<percent>]"
+              << std::endl;
+    return 1;
+  }
+
+  // Read before running anything so a missing baseline fails fast.
+  auto baseline = std::optional<llvm::json::Value>{};
+  if (options->baseline) {
+    auto file = llvm::MemoryBuffer::getFile(*options->baseline);
+    if (!file) {
+      throw std::runtime_error("Failed to open baseline " +
+                               *options->baseline + ": " +
+                               file.getError().message());
+    }
+    auto value = llvm::json::parse((*file)->getBuffer());
+    if (!value) {
+      throw std::runtime_error("Malformed baseline " + *options->baseline +
+                               ": " + llvm::toString(value.takeError()));
+    }
+    baseline = std::move(*value);
+  }
+
+  auto benchmarks = llvm::json::Array{};
+  for (const auto& workload : kWorkloads) {
+    if (workload.name.find(options->filter) == std::string_view::npos) {
+      continue;
+    }
+    const auto size = std::max<std::size_t>(
+        1, static_cast<std::size_t>(static_cast<double>(workload.size) *
+                                    options->scale));
+    benchmarks.push_back(RunInChild(*options, workload, size));
+  }
+
+  const auto is_within =
+      !baseline || CompareWithBaseline(*options, benchmarks, *baseline);
+
+  const auto results = llvm::json::Value(llvm::json::Object{
+      {"pipeline", options->pipeline},
+      {"emit", options->emit},
+      {"repeat", options->repeat},
+      {"benchmarks", std::move(benchmarks)},
+  });
+  if (!options->output) {
+    llvm::outs() << llvm::formatv("{0:2}", results) << "\n";
+  } else {
+    auto error = std::error_code{};
+    auto stream = llvm::raw_fd_ostream{*options->output, error};
+    if (error) {
+      throw std::runtime_error("Failed to open " + *options->output + ": " +
+                               error.message());
+    }
+    stream << llvm::formatv("{0:2}", results) << "\n";
+  }
+  return is_within ? 0 : 1;
+} catch (const std::exception& e) {
+  std::cerr << e.what() << std::endl;
+  return 1;
+}
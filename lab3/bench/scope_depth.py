@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""Times ParaParaCL on programs with deeply nested scopes.
+
+Every nesting level declares a local variable and reads variables declared at
+the outermost level, so name lookup cost grows with the nesting depth unless
+lookups are independent of it.
+
+Usage: scope_depth.py <ParaParaCL> [depth ...]
+"""
+
+import pathlib
+import subprocess
+import sys
+import tempfile
+import time
+
+VARIABLES = 16
+DEFAULT_DEPTHS = (1000, 2000, 4000, 8000, 16000)
+
+
+def generate(depth: int) -> str:
+    lines = [f"v{i} = {i};" for i in range(VARIABLES)]
+    # Levels aren't indented to keep the source size linear in the depth.
+    for level in range(depth):
+        first = level % VARIABLES
+        second = (level + 1) % VARIABLES
+        lines.append(f"local{level} = v{first} + v{second};")
+        lines.append(f"v{first} = local{level} % 1000;")
+        lines.append(f"if (v{second}) {{")
+    lines.extend("} else {\n}" for _ in range(depth))
+    lines.append("return v0;")
+    return "\n".join(lines) + "\n"
+
+
+def measure(compiler: str, source: pathlib.Path, repeat: int = 3) -> float:
+    best = float("inf")
+    for _ in range(repeat):
+        start = time.perf_counter()
+        subprocess.run(
+            [compiler, str(source)], check=True, stdout=subprocess.DEVNULL
+        )
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+def main() -> int:
+    compiler = sys.argv[1]
+    depths = [int(arg) for arg in sys.argv[2:]] or DEFAULT_DEPTHS
+    with tempfile.TemporaryDirectory() as directory:
+        print("depth,seconds")
+        for depth in depths:
+            source = pathlib.Path(directory) / f"depth-{depth}.dat"
+            source.write_text(generate(depth), encoding="utf-8")
+            print(f"{depth},{measure(compiler, source):.3f}", flush=True)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
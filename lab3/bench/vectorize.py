@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Times array kernels compiled with and without LLVM's vectorizers.
+
+Each kernel loops over arrays of 4096 elements many times; it's compiled
+with -O2 and with -O2 --no-vectorize to an object file, linked with the
+system C compiler, and the fastest of several runs is reported.
+
+Usage: vectorize.py <ParaParaCL> [compiler options ...]
+"""
+
+import pathlib
+import subprocess
+import sys
+import tempfile
+import time
+
+LENGTH = 4096
+ROUNDS = 20000
+
+FILL = (
+    f"array a[{LENGTH}];",
+    f"array b[{LENGTH}];",
+    f"array c[{LENGTH}];",
+    "i = 0;",
+    "while (i < len(a)) {",
+    "  a[i] = i % 17;",
+    "  b[i] = i % 5;",
+    "  i = i + 1;",
+    "}",
+)
+
+KERNELS = {
+    "axpy": (
+        "c[i] = a[i] * r + b[i];",
+        "s = c[r % len(c)];",
+    ),
+    "sum": (
+        "s = s + a[i] + b[i];",
+        "",
+    ),
+    "dot": (
+        "s = s + a[i] * b[i];",
+        "",
+    ),
+    "max": (
+        "if (a[i] + r > s) { s = a[i] + r; } else { }",
+        "",
+    ),
+}
+
+
+def generate(body: str, after: str) -> str:
+    lines = (
+        *FILL,
+        "s = 0;",
+        "r = 0;",
+        f"while (r < {ROUNDS}) {{",
+        "  i = 0;",
+        "  while (i < len(c)) {",
+        f"    {body}",
+        "    i = i + 1;",
+        "  }",
+        f"  {after}",
+        "  r = r + 1;",
+        "}",
+        "return s;",
+    )
+    return "\n".join(lines) + "\n"
+
+
+def build(
+    compiler: str, options: list[str], source: pathlib.Path, name: str
+) -> pathlib.Path:
+    obj = source.with_name(f"{name}.o")
+    executable = source.with_name(name)
+    subprocess.run(
+        [compiler, "-O2", *options, "--emit=obj", "-o", str(obj), str(source)],
+        check=True,
+    )
+    subprocess.run(["cc", str(obj), "-o", str(executable)], check=True)
+    return executable
+
+
+def measure(executable: pathlib.Path, repeat: int = 5) -> tuple[float, int]:
+    best = float("inf")
+    status = 0
+    for _ in range(repeat):
+        start = time.perf_counter()
+        status = subprocess.run([str(executable)], check=False).returncode
+        best = min(best, time.perf_counter() - start)
+    return best, status
+
+
+def main() -> int:
+    compiler = sys.argv[1]
+    options = sys.argv[2:]
+    with tempfile.TemporaryDirectory() as directory:
+        print("kernel,scalar_seconds,vector_seconds,speedup")
+        for kernel, (body, after) in KERNELS.items():
+            source = pathlib.Path(directory) / f"{kernel}.dat"
+            source.write_text(generate(body, after), encoding="utf-8")
+            scalar, scalar_status = measure(
+                build(compiler, [*options, "--no-vectorize"], source,
+                      f"{kernel}-scalar"))
+            vector, vector_status = measure(
+                build(compiler, options, source, f"{kernel}-vector"))
+            if scalar_status != vector_status:
+                print(f"{kernel}: results differ", file=sys.stderr)
+                return 1
+            print(f"{kernel},{scalar:.3f},{vector:.3f},{scalar / vector:.2f}",
+                  flush=True)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+// clang-format off
+#include "llvm/Support/Allocator.h"
+// clang-format on
+
+namespace frontend {
+
+// Bump allocator that owns every AST node of a program. Nodes are never
+// destroyed one by one: the slabs are released together with the arena, or
+// all at once by Reset, so everything placed in it must be trivially
+// destructible.
+class NodeArena final {
+ public:
+  template <typename T, typename... Args>
+  T* Make(Args&&... args) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    return new (allocator_.Allocate<T>()) T(std::forward<Args>(args)...);
+  }
+
+  template <typename T>
+  std::span<T> Copy(const std::span<const T> items) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (items.empty()) {
+      return {};
+    }
+
+    auto* const data = allocator_.Allocate<T>(items.size());
+    std::memcpy(data, items.data(), items.size_bytes());
+    return {data, items.size()};
+  }
+
+  // Releases every node but keeps the first slab for the next ones.
+  void Reset() {
+    peak_bytes_allocated_ = get_peak_bytes_allocated();
+    peak_total_memory_ = get_peak_total_memory();
+    allocator_.Reset();
+  }
+
+  std::size_t get_bytes_allocated() const noexcept {
+    return allocator_.getBytesAllocated();
+  }
+  std::size_t get_total_memory() const noexcept {
+    return allocator_.getTotalMemory();
+  }
+  // The most the arena held at once, across resets.
+  std::size_t get_peak_bytes_allocated() const noexcept {
+    return std::max(peak_bytes_allocated_, get_bytes_allocated());
+  }
+  std::size_t get_peak_total_memory() const noexcept {
+    return std::max(peak_total_memory_, get_total_memory());
+  }
+
+ private:
+  llvm::BumpPtrAllocator allocator_;
+  std::size_t peak_bytes_allocated_ = 0;
+  std::size_t peak_total_memory_ = 0;
+};
+
+}  // namespace frontend
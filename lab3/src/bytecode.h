@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace frontend {
+
+// Register index in the frame of a bytecode program.
+using Register = std::uint32_t;
+
+// Operands are named after their position: `a` is the destination register
+// or the jump target, `b` and `c` are source registers. Jump targets are
+// instruction indices.
+enum class Opcode : std::uint8_t {
+  kMove,  // a = b
+  kAdd,   // a = b + c, wrapping
+  kSub,
+  kMul,
+  kDiv,  // a = b / c, throws on a zero divisor
+  kMod,
+  kEq,  // a = b == c ? 1 : 0
+  kNe,
+  kLt,
+  kGt,
+  kLe,
+  kGe,
+  kAnd,  // a = b != 0 && c != 0 ? 1 : 0, both evaluated
+  kOr,
+  kNeg,  // a = -b, wrapping
+  kNot,  // a = b == 0 ? 1 : 0
+  kReturn,  // returns a
+  kCall,    // a = function b of the arguments in registers c, c + 1, ...
+
+  // An array is a register holding its length followed by a register per
+  // element. Accesses outside the array throw.
+  kZeroArray,     // a = b, and the b registers after a = 0
+  kLoadElement,   // a = element c of the array at b
+  kStoreElement,  // element b of the array at a = c
+
+  kJump,           // goto a
+  kJumpIfZero,     // if b == 0 goto a
+  kJumpIfNonZero,  // if b != 0 goto a
+
+  // Superinstructions. kAddImmediate updates a variable by a constant, as
+  // in `i = i + 1`, without a register for the constant; the immediate is
+  // stored in c as a two's complement 32-bit value. The compare-and-branch
+  // forms replace a comparison followed by a conditional jump.
+  kAddImmediate,  // a = b + c
+  kJumpIfEq,      // if b == c goto a
+  kJumpIfNe,
+  kJumpIfLt,
+  kJumpIfGt,
+  kJumpIfLe,
+  kJumpIfGe,
+};
+
+struct Instruction final {
+  Opcode op;
+  std::uint32_t a = 0;
+  std::uint32_t b = 0;
+  std::uint32_t c = 0;
+};
+
+// A compiled function. Every call gets a frame that holds the parameters and
+// variables first, then arrays and temporaries, then the constants, which
+// are loaded into their registers before the first instruction runs, so
+// instructions only ever read registers.
+struct BytecodeFunction final {
+  // The index of the first instruction.
+  std::uint32_t entry = 0;
+  Register param_count = 0;
+  std::vector<std::int64_t> constants;
+  Register constant_base = 0;
+  Register register_count = 0;
+};
+
+// A compiled program: main comes first, followed by the functions of the
+// program in the order of their FunctionIndex.
+struct Bytecode final {
+  std::vector<Instruction> code;
+  std::vector<BytecodeFunction> functions;
+};
+
+}  // namespace frontend
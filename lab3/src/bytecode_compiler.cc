@@ -0,0 +1,699 @@
+#include "bytecode_compiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace frontend {
+
+namespace {
+
+// Until TakeBytecode, a register operand with this bit set refers to a
+// constant by its index rather than to a register.
+constexpr std::uint32_t kConstantBit = std::uint32_t{1} << 31;
+
+// Which of the operands a, b and c name registers; the others are jump
+// targets, immediates or unused.
+std::array<bool, 3> GetRegisterOperands(const Opcode op) {
+  switch (op) {
+    case Opcode::kMove:
+    case Opcode::kNeg:
+    case Opcode::kNot:
+      return {true, true, false};
+    case Opcode::kAdd:
+    case Opcode::kSub:
+    case Opcode::kMul:
+    case Opcode::kDiv:
+    case Opcode::kMod:
+    case Opcode::kEq:
+    case Opcode::kNe:
+    case Opcode::kLt:
+    case Opcode::kGt:
+    case Opcode::kLe:
+    case Opcode::kGe:
+    case Opcode::kAnd:
+    case Opcode::kOr:
+      return {true, true, true};
+    case Opcode::kReturn:
+      return {true, false, false};
+    case Opcode::kCall:
+      return {true, false, true};
+    case Opcode::kZeroArray:
+      return {true, false, false};
+    case Opcode::kLoadElement:
+    case Opcode::kStoreElement:
+      return {true, true, true};
+    case Opcode::kJump:
+      return {false, false, false};
+    case Opcode::kJumpIfZero:
+    case Opcode::kJumpIfNonZero:
+      return {false, true, false};
+    case Opcode::kAddImmediate:
+      return {true, true, false};
+    case Opcode::kJumpIfEq:
+    case Opcode::kJumpIfNe:
+    case Opcode::kJumpIfLt:
+    case Opcode::kJumpIfGt:
+    case Opcode::kJumpIfLe:
+    case Opcode::kJumpIfGe:
+      return {false, true, true};
+  }
+  return {false, false, false};
+}
+
+// The instruction computing the operator, or kAnd and kOr for both logical
+// operators, which evaluate eagerly.
+Opcode GetOpcode(const BinaryExpr::Op op) {
+  switch (op) {
+    using enum BinaryExpr::Op;
+    case kAdd:
+      return Opcode::kAdd;
+    case kSub:
+      return Opcode::kSub;
+    case kMul:
+      return Opcode::kMul;
+    case kDiv:
+      return Opcode::kDiv;
+    case kMod:
+      return Opcode::kMod;
+    case kEq:
+      return Opcode::kEq;
+    case kNe:
+      return Opcode::kNe;
+    case kLt:
+      return Opcode::kLt;
+    case kGt:
+      return Opcode::kGt;
+    case kLe:
+      return Opcode::kLe;
+    case kGe:
+      return Opcode::kGe;
+    case kAnd:
+      return Opcode::kAnd;
+    case kOr:
+      return Opcode::kOr;
+  }
+  return Opcode::kAdd;
+}
+
+// The compare-and-branch jumping when the comparison holds, or when it
+// doesn't if `when` is false.
+std::optional<Opcode> GetCompareJump(const BinaryExpr::Op op, const bool when) {
+  switch (op) {
+    using enum BinaryExpr::Op;
+    case kEq:
+      return when ? Opcode::kJumpIfEq : Opcode::kJumpIfNe;
+    case kNe:
+      return when ? Opcode::kJumpIfNe : Opcode::kJumpIfEq;
+    case kLt:
+      return when ? Opcode::kJumpIfLt : Opcode::kJumpIfGe;
+    case kGt:
+      return when ? Opcode::kJumpIfGt : Opcode::kJumpIfLe;
+    case kLe:
+      return when ? Opcode::kJumpIfLe : Opcode::kJumpIfGt;
+    case kGe:
+      return when ? Opcode::kJumpIfGe : Opcode::kJumpIfLt;
+    default:
+      return std::nullopt;
+  }
+}
+
+// Returns the constant as an immediate of kAddImmediate, negated for a
+// subtraction, if it fits.
+std::optional<std::uint32_t> GetImmediate(const IExpr& expr,
+                                          const bool is_negated) {
+  const auto* const number = llvm::dyn_cast<NumberExpr>(&expr);
+  if (number == nullptr) {
+    return std::nullopt;
+  }
+
+  constexpr auto kLimit =
+      std::int64_t{std::numeric_limits<std::int32_t>::max()};
+  const auto value = number->get_value();
+  if (value < -kLimit || value > kLimit) {
+    return std::nullopt;
+  }
+  return static_cast<std::uint32_t>(
+      static_cast<std::int32_t>(is_negated ? -value : value));
+}
+
+}  // namespace
+
+BytecodeCompiler::BytecodeCompiler(const Slot slot_count,
+                                   const CodeGenOptions& options)
+    : options_(options) {
+  BeginFunction(slot_count, 0);
+}
+
+void BytecodeCompiler::Visit(Program& program) {
+  VisitBlock(program.get_stmts());
+  CheckTerminated();
+  auto main = EndFunction();
+  bytecode_.functions.resize(program.get_functions().size() + 1);
+  bytecode_.functions.front() = std::move(main);
+
+  for (auto* const def : program.get_functions()) {
+    def->Accept(*this);
+  }
+}
+
+void BytecodeCompiler::Visit(FunctionDef& def) {
+  BeginFunction(def.get_slot_count(),
+                static_cast<Register>(def.get_params().size()));
+  VisitBlock(def.get_stmts());
+  CheckTerminated();
+
+  const auto index = std::size_t{def.get_index()} + 1;
+  if (index >= bytecode_.functions.size()) {
+    bytecode_.functions.resize(index + 1);
+  }
+  bytecode_.functions[index] = EndFunction();
+}
+
+void BytecodeCompiler::Visit(AssignStmt& stmt) {
+  Evaluate(stmt.get_expr(), stmt.get_slot());
+}
+
+void BytecodeCompiler::Visit(StoreStmt& stmt) {
+  const auto index = Evaluate(stmt.get_index());
+  const auto value = Evaluate(stmt.get_expr());
+  Emit(Opcode::kStoreElement, arrays_[stmt.get_slot()], index, value);
+}
+
+void BytecodeCompiler::Visit(ArrayDeclStmt& stmt) {
+  // No temporary is live between statements, so the array can take the
+  // place of the first ones, and the statements that follow allocate theirs
+  // above it. Registers of arrays are never reused within a function.
+  const auto slot = stmt.get_slot();
+  if (slot >= arrays_.size()) {
+    arrays_.resize(slot + 1);
+  }
+  const auto length = static_cast<Register>(stmt.get_length());
+  arrays_[slot] = first_temporary_;
+  Emit(Opcode::kZeroArray, first_temporary_, length);
+  first_temporary_ = next_temporary_ = first_temporary_ + length + 1;
+  temporary_end_ = std::max(temporary_end_, first_temporary_);
+}
+
+void BytecodeCompiler::Visit(IfStmt& stmt) {
+  auto else_jumps = std::vector<std::size_t>{};
+  EmitBranch(stmt.get_cond(), false, else_jumps);
+
+  VisitBlock(stmt.get_then_stmts());
+  const auto is_then_terminated = is_terminated_;
+  auto end_jumps = std::vector<std::size_t>{};
+  if (!is_then_terminated) {
+    end_jumps.push_back(Emit(Opcode::kJump));
+  }
+
+  PatchJumps(else_jumps, bytecode_.code.size());
+  VisitBlock(stmt.get_else_stmts());
+  PatchJumps(end_jumps, bytecode_.code.size());
+  is_terminated_ = is_then_terminated && is_terminated_;
+}
+
+void BytecodeCompiler::Visit(WhileStmt& stmt) {
+  // The condition is tested at the bottom, so the loop takes one branch per
+  // iteration.
+  const auto entry_jump = Emit(Opcode::kJump);
+  const auto body = bytecode_.code.size();
+  VisitBlock(stmt.get_stmts());
+
+  PatchJumps({entry_jump}, bytecode_.code.size());
+  auto body_jumps = std::vector<std::size_t>{};
+  EmitBranch(stmt.get_cond(), true, body_jumps);
+  PatchJumps(body_jumps, body);
+  is_terminated_ = false;
+}
+
+void BytecodeCompiler::Visit(ReturnStmt& stmt) {
+  Emit(Opcode::kReturn, Evaluate(stmt.get_expr()));
+  is_terminated_ = true;
+}
+
+void BytecodeCompiler::Visit(BinaryExpr& expr) { Evaluate(expr); }
+
+void BytecodeCompiler::Visit(UnaryExpr& expr) { Evaluate(expr); }
+
+void BytecodeCompiler::Visit(VarExpr& expr) { Evaluate(expr); }
+
+void BytecodeCompiler::Visit(NumberExpr& expr) { Evaluate(expr); }
+
+void BytecodeCompiler::Visit(CallExpr& expr) { Evaluate(expr); }
+
+void BytecodeCompiler::Visit(IndexExpr& expr) { Evaluate(expr); }
+
+void BytecodeCompiler::Visit(LengthExpr& expr) { Evaluate(expr); }
+
+Bytecode BytecodeCompiler::TakeBytecode() {
+  // Statements visited without their program make up main.
+  if (bytecode_.functions.empty()) {
+    bytecode_.functions.push_back(EndFunction());
+  }
+  return std::move(bytecode_);
+}
+
+void BytecodeCompiler::BeginFunction(const Slot slot_count,
+                                     const Register param_count) {
+  function_ = {};
+  function_.entry = static_cast<std::uint32_t>(bytecode_.code.size());
+  function_.param_count = param_count;
+  first_temporary_ = next_temporary_ = temporary_end_ = slot_count;
+  arrays_.clear();
+  constant_indices_.clear();
+  is_terminated_ = false;
+}
+
+BytecodeFunction BytecodeCompiler::EndFunction() {
+  function_.constant_base = temporary_end_;
+  function_.register_count =
+      temporary_end_ + static_cast<Register>(function_.constants.size());
+
+  const auto code = std::span{bytecode_.code}.subspan(function_.entry);
+  for (auto& instruction : code) {
+    const auto is_register = GetRegisterOperands(instruction.op);
+    for (auto i = 0U; i < is_register.size(); ++i) {
+      auto& operand = i == 0   ? instruction.a
+                      : i == 1 ? instruction.b
+                               : instruction.c;
+      if (is_register[i] && (operand & kConstantBit) != 0) {
+        operand = function_.constant_base + (operand & ~kConstantBit);
+      }
+    }
+  }
+  return std::move(function_);
+}
+
+void BytecodeCompiler::CheckTerminated() const {
+  if (!is_terminated_) {
+    throw std::runtime_error(
+        "Reachable control-flow path falls through without return");
+  }
+}
+
+Register BytecodeCompiler::Evaluate(IExpr& expr, const Register destination) {
+  tasks_.push_back({.action = Task::Action::kEvaluate,
+                    .expr = &expr,
+                    .destination = destination});
+  RunTasks();
+  return PopResult();
+}
+
+void BytecodeCompiler::EmitBranch(IExpr& expr, const bool when,
+                                  std::vector<std::size_t>& jumps) {
+  tasks_.push_back({.action = Task::Action::kBranch,
+                    .expr = &expr,
+                    .when = when,
+                    .jumps = &jumps});
+  RunTasks();
+}
+
+void BytecodeCompiler::RunTasks() {
+  while (!tasks_.empty()) {
+    const auto task = tasks_.back();
+    tasks_.pop_back();
+    switch (task.action) {
+      using enum Task::Action;
+      case kEvaluate: {
+        LowerEvaluate(task);
+        break;
+      }
+      case kBranch: {
+        LowerBranch(task);
+        break;
+      }
+      case kPatchSkip: {
+        PatchJumps(skip_jumps_.back(), bytecode_.code.size());
+        skip_jumps_.pop_back();
+        break;
+      }
+      case kBinary: {
+        FinishBinary(task);
+        break;
+      }
+      case kAddImmediate: {
+        FinishAddImmediate(task);
+        break;
+      }
+      case kUnary: {
+        FinishUnary(task);
+        break;
+      }
+      case kShortCircuit: {
+        FinishShortCircuit(task);
+        break;
+      }
+      case kCompareJump: {
+        const auto rhs = PopResult();
+        const auto lhs = PopResult();
+        next_temporary_ = task.mark;
+        const auto op = llvm::cast<BinaryExpr>(task.expr)->get_op();
+        task.jumps->push_back(
+            Emit(*GetCompareJump(op, task.when), 0, lhs, rhs));
+        break;
+      }
+      case kJumpIfValue: {
+        const auto value = PopResult();
+        next_temporary_ = task.mark;
+        task.jumps->push_back(Emit(
+            task.when ? Opcode::kJumpIfNonZero : Opcode::kJumpIfZero, 0,
+            value));
+        break;
+      }
+      case kCall: {
+        FinishCall(task);
+        break;
+      }
+      case kIndex: {
+        FinishIndex(task);
+        break;
+      }
+    }
+  }
+}
+
+void BytecodeCompiler::LowerEvaluate(const Task& task) {
+  using Action = Task::Action;
+  const auto destination = task.destination;
+  const auto mark = next_temporary_;
+
+  switch (task.expr->get_kind()) {
+    case NodeKind::kBinaryExpr: {
+      auto& expr = *llvm::cast<BinaryExpr>(task.expr);
+      const auto op = expr.get_op();
+      if (options_.short_circuit &&
+          (op == BinaryExpr::Op::kAnd || op == BinaryExpr::Op::kOr)) {
+        // The destination may be read by the operands, so the value is built
+        // in a temporary.
+        const auto value = AllocateTemporary();
+        auto& jumps = skip_jumps_.emplace_back();
+        tasks_.push_back({.action = Action::kShortCircuit,
+                          .expr = &expr,
+                          .destination = destination,
+                          .mark = mark,
+                          .operand = value});
+        tasks_.push_back({.action = Action::kBranch,
+                          .expr = &expr,
+                          .when = op != BinaryExpr::Op::kAnd,
+                          .jumps = &jumps});
+        return;
+      }
+
+      if (op == BinaryExpr::Op::kAdd || op == BinaryExpr::Op::kSub) {
+        const auto is_sub = op == BinaryExpr::Op::kSub;
+        auto* operand = &expr.get_lhs();
+        auto immediate = GetImmediate(expr.get_rhs(), is_sub);
+        if (!immediate && !is_sub) {
+          operand = &expr.get_rhs();
+          immediate = GetImmediate(expr.get_lhs(), false);
+        }
+        if (immediate) {
+          tasks_.push_back({.action = Action::kAddImmediate,
+                            .expr = &expr,
+                            .destination = destination,
+                            .mark = mark,
+                            .operand = *immediate});
+          tasks_.push_back({.action = Action::kEvaluate, .expr = operand});
+          return;
+        }
+      }
+
+      tasks_.push_back({.action = Action::kBinary,
+                        .expr = &expr,
+                        .destination = destination,
+                        .mark = mark});
+      tasks_.push_back({.action = Action::kEvaluate, .expr = &expr.get_rhs()});
+      tasks_.push_back({.action = Action::kEvaluate, .expr = &expr.get_lhs()});
+      return;
+    }
+    case NodeKind::kUnaryExpr: {
+      auto& expr = *llvm::cast<UnaryExpr>(task.expr);
+      tasks_.push_back({.action = Action::kUnary,
+                        .expr = &expr,
+                        .destination = destination,
+                        .mark = mark});
+      tasks_.push_back({.action = Action::kEvaluate, .expr = &expr.get_expr()});
+      return;
+    }
+    case NodeKind::kVarExpr: {
+      auto result = llvm::cast<VarExpr>(task.expr)->get_slot();
+      if (destination != kNoRegister && destination != result) {
+        Emit(Opcode::kMove, destination, result);
+        result = destination;
+      }
+      results_.push_back(result);
+      return;
+    }
+    case NodeKind::kCallExpr: {
+      // The arguments go to consecutive temporaries starting at the mark.
+      auto& expr = *llvm::cast<CallExpr>(task.expr);
+      const auto args = expr.get_args();
+      for (auto i = 0U; i < args.size(); ++i) {
+        AllocateTemporary();
+      }
+      tasks_.push_back({.action = Action::kCall,
+                        .expr = &expr,
+                        .destination = destination,
+                        .mark = mark});
+      for (auto i = args.size(); i-- > 0;) {
+        tasks_.push_back({.action = Action::kEvaluate,
+                          .expr = args[i],
+                          .destination = mark + static_cast<Register>(i)});
+      }
+      return;
+    }
+    case NodeKind::kIndexExpr: {
+      auto& expr = *llvm::cast<IndexExpr>(task.expr);
+      tasks_.push_back({.action = Action::kIndex,
+                        .expr = &expr,
+                        .destination = destination,
+                        .mark = mark});
+      tasks_.push_back(
+          {.action = Action::kEvaluate, .expr = &expr.get_index()});
+      return;
+    }
+    case NodeKind::kNumberExpr:
+    case NodeKind::kLengthExpr: {
+      const auto* const number = llvm::dyn_cast<NumberExpr>(task.expr);
+      auto result = GetConstant(
+          number != nullptr
+              ? number->get_value()
+              : llvm::cast<LengthExpr>(task.expr)->get_length());
+      if (destination != kNoRegister) {
+        Emit(Opcode::kMove, destination, result);
+        result = destination;
+      }
+      results_.push_back(result);
+      return;
+    }
+    default: {
+      return;
+    }
+  }
+}
+
+void BytecodeCompiler::LowerBranch(const Task& task) {
+  using Action = Task::Action;
+  auto& jumps = *task.jumps;
+  const auto when = task.when;
+  const auto mark = next_temporary_;
+
+  if (auto* const binary = llvm::dyn_cast<BinaryExpr>(task.expr)) {
+    const auto op = binary->get_op();
+    if (GetCompareJump(op, when)) {
+      tasks_.push_back({.action = Action::kCompareJump,
+                        .expr = binary,
+                        .mark = mark,
+                        .when = when,
+                        .jumps = &jumps});
+      tasks_.push_back(
+          {.action = Action::kEvaluate, .expr = &binary->get_rhs()});
+      tasks_.push_back(
+          {.action = Action::kEvaluate, .expr = &binary->get_lhs()});
+      return;
+    }
+
+    const auto is_and = op == BinaryExpr::Op::kAnd;
+    if (options_.short_circuit && (is_and || op == BinaryExpr::Op::kOr)) {
+      // The lhs decides the result when it's false for && and true for ||.
+      if (when != is_and) {
+        tasks_.push_back({.action = Action::kBranch,
+                          .expr = &binary->get_rhs(),
+                          .when = when,
+                          .jumps = &jumps});
+        tasks_.push_back({.action = Action::kBranch,
+                          .expr = &binary->get_lhs(),
+                          .when = when,
+                          .jumps = &jumps});
+      } else {
+        auto& skip_jumps = skip_jumps_.emplace_back();
+        tasks_.push_back({.action = Action::kPatchSkip});
+        tasks_.push_back({.action = Action::kBranch,
+                          .expr = &binary->get_rhs(),
+                          .when = when,
+                          .jumps = &jumps});
+        tasks_.push_back({.action = Action::kBranch,
+                          .expr = &binary->get_lhs(),
+                          .when = !when,
+                          .jumps = &skip_jumps});
+      }
+      return;
+    }
+  }
+
+  if (auto* const unary = llvm::dyn_cast<UnaryExpr>(task.expr);
+      unary != nullptr && unary->get_op() == UnaryExpr::Op::kNot) {
+    tasks_.push_back({.action = Action::kBranch,
+                      .expr = &unary->get_expr(),
+                      .when = !when,
+                      .jumps = &jumps});
+    return;
+  }
+
+  if (const auto* const number = llvm::dyn_cast<NumberExpr>(task.expr)) {
+    if ((number->get_value() != 0) == when) {
+      jumps.push_back(Emit(Opcode::kJump));
+    }
+    return;
+  }
+
+  tasks_.push_back({.action = Action::kJumpIfValue,
+                    .expr = task.expr,
+                    .mark = mark,
+                    .when = when,
+                    .jumps = &jumps});
+  tasks_.push_back({.action = Action::kEvaluate, .expr = task.expr});
+}
+
+void BytecodeCompiler::FinishBinary(const Task& task) {
+  const auto rhs = PopResult();
+  const auto lhs = PopResult();
+  next_temporary_ = task.mark;
+  const auto result = GetResultRegister(task.destination);
+  Emit(GetOpcode(llvm::cast<BinaryExpr>(task.expr)->get_op()), result, lhs,
+       rhs);
+  results_.push_back(result);
+}
+
+void BytecodeCompiler::FinishAddImmediate(const Task& task) {
+  const auto source = PopResult();
+  next_temporary_ = task.mark;
+  const auto result = GetResultRegister(task.destination);
+  Emit(Opcode::kAddImmediate, result, source, task.operand);
+  results_.push_back(result);
+}
+
+void BytecodeCompiler::FinishUnary(const Task& task) {
+  const auto value = PopResult();
+  next_temporary_ = task.mark;
+  const auto result = GetResultRegister(task.destination);
+
+  switch (llvm::cast<UnaryExpr>(task.expr)->get_op()) {
+    using enum UnaryExpr::Op;
+    case kNeg: {
+      Emit(Opcode::kNeg, result, value);
+      break;
+    }
+    case kNot: {
+      Emit(Opcode::kNot, result, value);
+      break;
+    }
+  }
+  results_.push_back(result);
+}
+
+void BytecodeCompiler::FinishShortCircuit(const Task& task) {
+  const auto is_and =
+      llvm::cast<BinaryExpr>(task.expr)->get_op() == BinaryExpr::Op::kAnd;
+  const auto value = Register{task.operand};
+  Emit(Opcode::kMove, value, GetConstant(is_and ? 1 : 0));
+  const auto end_jump = Emit(Opcode::kJump);
+  PatchJumps(skip_jumps_.back(), bytecode_.code.size());
+  skip_jumps_.pop_back();
+  Emit(Opcode::kMove, value, GetConstant(is_and ? 0 : 1));
+  PatchJumps({end_jump}, bytecode_.code.size());
+
+  auto result = value;
+  if (task.destination != kNoRegister) {
+    Emit(Opcode::kMove, task.destination, value);
+    next_temporary_ = task.mark;
+    result = task.destination;
+  }
+  results_.push_back(result);
+}
+
+void BytecodeCompiler::FinishCall(const Task& task) {
+  auto& expr = *llvm::cast<CallExpr>(task.expr);
+  results_.resize(results_.size() - expr.get_args().size());
+  next_temporary_ = task.mark;
+  const auto result = GetResultRegister(task.destination);
+  Emit(Opcode::kCall, result, expr.get_function() + 1, task.mark);
+  results_.push_back(result);
+}
+
+void BytecodeCompiler::FinishIndex(const Task& task) {
+  auto& expr = *llvm::cast<IndexExpr>(task.expr);
+  const auto index = PopResult();
+  next_temporary_ = task.mark;
+  const auto result = GetResultRegister(task.destination);
+  Emit(Opcode::kLoadElement, result, arrays_[expr.get_slot()], index);
+  results_.push_back(result);
+}
+
+Register BytecodeCompiler::PopResult() {
+  const auto result = results_.back();
+  results_.pop_back();
+  return result;
+}
+
+Register BytecodeCompiler::GetResultRegister(const Register destination) {
+  return destination != kNoRegister ? destination : AllocateTemporary();
+}
+
+std::size_t BytecodeCompiler::Emit(const Opcode op, const std::uint32_t a,
+                                   const std::uint32_t b,
+                                   const std::uint32_t c) {
+  bytecode_.code.push_back({op, a, b, c});
+  return bytecode_.code.size() - 1;
+}
+
+void BytecodeCompiler::PatchJumps(const std::vector<std::size_t>& jumps,
+                                  const std::size_t target) {
+  for (const auto jump : jumps) {
+    bytecode_.code[jump].a = static_cast<std::uint32_t>(target);
+  }
+}
+
+Register BytecodeCompiler::GetConstant(const std::int64_t value) {
+  const auto [it, is_inserted] = constant_indices_.try_emplace(
+      value, static_cast<std::uint32_t>(function_.constants.size()));
+  if (is_inserted) {
+    function_.constants.push_back(value);
+  }
+  return it->second | kConstantBit;
+}
+
+Register BytecodeCompiler::AllocateTemporary() {
+  const auto temporary = next_temporary_++;
+  temporary_end_ = std::max(temporary_end_, next_temporary_);
+  return temporary;
+}
+
+void BytecodeCompiler::VisitBlock(const StmtList stmts) {
+  is_terminated_ = false;
+  for (auto* const stmt : stmts) {
+    if (is_terminated_) {
+      break;
+    }
+    stmt->Accept(*this);
+    next_temporary_ = first_temporary_;
+  }
+}
+
+}  // namespace frontend
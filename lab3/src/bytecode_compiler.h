@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "bytecode.h"
+#include "code_generator.h"
+#include "node.h"
+#include "symbol_table.h"
+#include "visitor.h"
+
+namespace frontend {
+
+// Compiles the resolved AST to register bytecode for the Interpreter, as an
+// alternative to CodeGenerator that needs no LLVM. Variables live in the
+// registers numbered by their slots and expressions are evaluated straight
+// into the register of the variable they're assigned to. Conditions of `if`
+// and `while` become compare-and-branch instructions, and loops test their
+// condition at the bottom, so one iteration of a counting loop dispatches
+// only its body and one branch. Every function is compiled into a frame of its
+// own, and the arguments of a call are evaluated into consecutive temporaries
+// that the callee's frame takes as its parameters. Arrays take registers of
+// the frame from their declaration on, below the temporaries of the
+// statements that follow. Expressions are compiled
+// from an explicit work stack, so operator chains of any length compile in
+// constant stack space.
+class BytecodeCompiler final : public IVisitor {
+ public:
+  // Takes the number of slots main uses.
+  BytecodeCompiler(Slot slot_count, const CodeGenOptions& options = {});
+
+  void Visit(Program& program) override;
+  void Visit(FunctionDef& def) override;
+  void Visit(AssignStmt& stmt) override;
+  void Visit(StoreStmt& stmt) override;
+  void Visit(ArrayDeclStmt& stmt) override;
+  void Visit(IfStmt& stmt) override;
+  void Visit(WhileStmt& stmt) override;
+  void Visit(ReturnStmt& stmt) override;
+  void Visit(BinaryExpr& expr) override;
+  void Visit(UnaryExpr& expr) override;
+  void Visit(VarExpr& expr) override;
+  void Visit(NumberExpr& expr) override;
+  void Visit(CallExpr& expr) override;
+  void Visit(IndexExpr& expr) override;
+  void Visit(LengthExpr& expr) override;
+
+  // Returns the program; the compiler can't be used afterwards.
+  Bytecode TakeBytecode();
+
+ private:
+  static constexpr Register kNoRegister = std::numeric_limits<Register>::max();
+
+  // One step of compiling an expression. Operators push the steps for their
+  // operands followed by the step that finishes them, which pops the
+  // registers of the operands from results_.
+  struct Task final {
+    enum class Action : std::uint8_t {
+      // Evaluates `expr` into `destination`, or into any register.
+      kEvaluate,
+      // Appends to `jumps` the jumps taken if the truth of `expr` equals
+      // `when`.
+      kBranch,
+      // Patches the innermost jump list of skip_jumps_ to the next
+      // instruction and drops it.
+      kPatchSkip,
+      kBinary,
+      kAddImmediate,
+      kUnary,
+      kShortCircuit,
+      kCompareJump,
+      kJumpIfValue,
+      kCall,
+      kIndex,
+    };
+
+    Action action;
+    IExpr* expr = nullptr;
+    Register destination = kNoRegister;
+    // The first free temporary when the step was scheduled.
+    Register mark = 0;
+    // The register holding the value of a short-circuit operator, or the
+    // immediate of kAddImmediate.
+    std::uint32_t operand = 0;
+    bool when = false;
+    std::vector<std::size_t>* jumps = nullptr;
+  };
+
+  // Evaluates the expression into the destination register, or into any
+  // register if there's none, and returns that register.
+  Register Evaluate(IExpr& expr, Register destination = kNoRegister);
+  // Jumps if the truth of the expression equals `when` and falls through
+  // otherwise. The jumps are appended to `jumps` to be patched later.
+  void EmitBranch(IExpr& expr, bool when, std::vector<std::size_t>& jumps);
+  void RunTasks();
+  void LowerEvaluate(const Task& task);
+  void LowerBranch(const Task& task);
+  void FinishBinary(const Task& task);
+  void FinishAddImmediate(const Task& task);
+  void FinishUnary(const Task& task);
+  void FinishShortCircuit(const Task& task);
+  void FinishCall(const Task& task);
+  void FinishIndex(const Task& task);
+  Register PopResult();
+  // Returns the destination, or a fresh temporary if there's none.
+  Register GetResultRegister(Register destination);
+  std::size_t Emit(Opcode op, std::uint32_t a = 0, std::uint32_t b = 0,
+                   std::uint32_t c = 0);
+  void PatchJumps(const std::vector<std::size_t>& jumps, std::size_t target);
+  Register GetConstant(std::int64_t value);
+  Register AllocateTemporary();
+  void VisitBlock(StmtList stmts);
+  // Starts a function whose code follows the code compiled so far.
+  void BeginFunction(Slot slot_count, Register param_count);
+  // Places the constants of the function after its temporaries and returns
+  // it.
+  BytecodeFunction EndFunction();
+  void CheckTerminated() const;
+
+ private:
+  CodeGenOptions options_;
+  Bytecode bytecode_;
+  // The function being compiled.
+  BytecodeFunction function_;
+  // The first register of every array, indexed by slot.
+  std::vector<Register> arrays_;
+  // Temporaries follow the variables and arrays and are allocated as a
+  // stack.
+  Register first_temporary_;
+  Register next_temporary_;
+  Register temporary_end_;
+  // Constants are referenced by index until their registers are known.
+  std::unordered_map<std::int64_t, std::uint32_t> constant_indices_;
+
+  std::vector<Task> tasks_;
+  std::vector<Register> results_;
+  // Jumps over the right operand of a short-circuit operator, innermost last.
+  // A deque keeps the lists in place while inner ones are added.
+  std::deque<std::vector<std::size_t>> skip_jumps_;
+  bool is_terminated_ = false;
+};
+
+}  // namespace frontend
@@ -0,0 +1,177 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// clang-format off
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Host.h"
+// clang-format on
+
+#include "profile.h"
+#include "source_hash.h"
+
+namespace frontend {
+
+namespace {
+
+// Changes whenever the layout of the cache or of its keys does.
+constexpr std::string_view kCacheFormat = "paraparacl-cache-1";
+
+// Entries are named by their key, 64 hexadecimal digits; everything else in
+// the directory is a temporary file being written.
+constexpr std::size_t kKeyLength = 64;
+
+}  // namespace
+
+Cache::Cache(std::string directory, const std::uint64_t max_bytes)
+    : directory_(std::move(directory)), max_bytes_(max_bytes) {
+  if (const auto error = llvm::sys::fs::create_directories(directory_)) {
+    throw std::runtime_error("Failed to create the cache directory " +
+                             directory_ + ": " + error.message());
+  }
+}
+
+std::string Cache::GetKey(const std::string_view source,
+                          const Options& options) {
+  auto hasher = llvm::SHA256{};
+  // Every field is preceded by its size, so that different fields never hash
+  // the same bytes.
+  const auto add = [&hasher](const std::string_view field) {
+    const auto size = static_cast<std::uint64_t>(field.size());
+    hasher.update(llvm::ArrayRef<std::uint8_t>{
+        reinterpret_cast<const std::uint8_t*>(&size), sizeof(size)});
+    hasher.update(llvm::StringRef{field.data(), field.size()});
+  };
+
+  add(kCacheFormat);
+  add(PARAPARACL_SOURCE_HASH);
+  add(LLVM_VERSION_STRING);
+  add(llvm::sys::getProcessTriple());
+  add(options.target_cpu);
+  if (options.target_cpu == "native") {
+    add(llvm::sys::getHostCPUName());
+  }
+  add(options.pipeline);
+  add(std::to_string(
+      static_cast<int>(options.emit_kind.value_or(EmitKind::kIr))));
+  add(options.codegen.short_circuit ? "short-circuit" : "eager");
+  add(options.codegen.vectorize ? "vectorize" : "no-vectorize");
+  add(options.codegen.check_division ? "check-division" : "no-check-division");
+  add(options.codegen.instrument);
+  add(options.codegen.profile ? options.codegen.profile->get_contents()
+                              : std::string_view{});
+  add(source);
+  return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> Cache::Find(const std::string& key) const {
+  const auto path = GetPath(key);
+  auto fd = 0;
+  if (llvm::sys::fs::openFileForRead(path, fd)) {
+    return nullptr;
+  }
+
+  // Eviction goes by modification time, so reading an entry touches it.
+  llvm::sys::fs::setLastAccessAndModificationTime(
+      fd, std::chrono::time_point_cast<std::chrono::nanoseconds>(
+              std::chrono::system_clock::now()));
+  auto buffer = llvm::MemoryBuffer::getOpenFile(
+      fd, path, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+  if (!buffer) {
+    return nullptr;
+  }
+  return std::move(*buffer);
+}
+
+void Cache::Store(const std::string& key, const std::string_view contents) {
+  auto temp = llvm::sys::fs::TempFile::create(directory_ + "/tmp-%%%%%%%%");
+  if (!temp) {
+    llvm::consumeError(temp.takeError());
+    return;
+  }
+
+  auto output = llvm::raw_fd_ostream{temp->FD, /*shouldClose=*/false};
+  output.write(contents.data(), contents.size());
+  output.flush();
+  if (output.has_error()) {
+    output.clear_error();
+    llvm::consumeError(temp->discard());
+    return;
+  }
+  // Renaming replaces an entry another process stored meanwhile as a whole.
+  if (auto error = temp->keep(GetPath(key))) {
+    llvm::consumeError(std::move(error));
+    return;
+  }
+
+  const auto lock = std::scoped_lock{mutex_};
+  if (bytes_used_) {
+    *bytes_used_ += contents.size();
+  }
+  if (!bytes_used_ || *bytes_used_ > max_bytes_) {
+    Evict();
+  }
+}
+
+std::string Cache::GetPath(const std::string& key) const {
+  auto path = llvm::SmallString<128>{directory_};
+  llvm::sys::path::append(path, key);
+  return path.str().str();
+}
+
+void Cache::Evict() {
+  struct Entry final {
+    std::string path;
+    llvm::sys::TimePoint<> last_used;
+    std::uint64_t size;
+  };
+
+  auto entries = std::vector<Entry>{};
+  auto bytes_used = std::uint64_t{0};
+  auto error = std::error_code{};
+  for (auto it = llvm::sys::fs::directory_iterator{directory_, error};
+       !error && it != llvm::sys::fs::directory_iterator{};
+       it.increment(error)) {
+    if (llvm::sys::path::filename(it->path()).size() != kKeyLength) {
+      continue;
+    }
+    const auto status = it->status();
+    if (!status || status->type() != llvm::sys::fs::file_type::regular_file) {
+      continue;
+    }
+    entries.push_back({it->path(), status->getLastModificationTime(),
+                       status->getSize()});
+    bytes_used += status->getSize();
+  }
+
+  if (bytes_used > max_bytes_) {
+    std::ranges::sort(entries, {}, &Entry::last_used);
+    const auto low_water_mark = max_bytes_ / 5 * 4;
+    for (const auto& entry : entries) {
+      if (bytes_used <= low_water_mark) {
+        break;
+      }
+      if (!llvm::sys::fs::remove(entry.path)) {
+        bytes_used -= entry.size;
+      }
+    }
+  }
+  bytes_used_ = bytes_used;
+}
+
+}  // namespace frontend
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "options.h"
+
+namespace llvm {
+class MemoryBuffer;
+}  // namespace llvm
+
+namespace frontend {
+
+// Outputs of earlier compilations, stored in a directory under a SHA-256 of
+// everything that determines them: the source, a hash of the sources of the
+// compiler, the LLVM version, the host, and the options that change the
+// output. Entries are written to a temporary file and renamed into place, so
+// readers never see a partial one, and the least recently used ones are
+// removed once the directory outgrows its limit. Several threads and
+// processes may share a cache.
+class Cache final {
+ public:
+  // Creates the directory if it doesn't exist.
+  Cache(std::string directory, std::uint64_t max_bytes);
+
+  static std::string GetKey(std::string_view source, const Options& options);
+
+  // Returns the entry stored under the key, marking it as recently used, or
+  // nothing on a miss.
+  std::unique_ptr<llvm::MemoryBuffer> Find(const std::string& key) const;
+
+  // Stores an entry and evicts old ones if the cache has grown too large.
+  // Failures are ignored: another process may be evicting the same entries,
+  // and a missing entry only costs a recompilation.
+  void Store(const std::string& key, std::string_view contents);
+
+ private:
+  std::string GetPath(const std::string& key) const;
+  // Counts the size of the entries and, if they exceed the limit, removes the
+  // least recently used ones until they're down to 80% of it, so that the
+  // directory isn't scanned again on every store.
+  void Evict();
+
+ private:
+  std::string directory_;
+  std::uint64_t max_bytes_;
+  std::mutex mutex_;
+  // Counted by the first store and kept up to date by later ones, so it's
+  // approximate if other processes share the cache; Evict recounts it.
+  std::optional<std::uint64_t> bytes_used_;
+};
+
+}  // namespace frontend
@@ -1,380 +1,2015 @@
 #include "code_generator.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <stdexcept>
-#include <unordered_map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 // clang-format off
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
 // clang-format on
 
+#include "llvm_error.h"
 #include "node.h"
+#include "profile.h"
+#include "range_analysis.h"
+#include "session.h"
+#include "statistics.h"
 
 namespace frontend {
 
 namespace {
 
-class Scope final {
+// A variable resolved to a slot. Its value is tracked per basic block as the
+// SSA value reaching the end of that block; the handles follow RAUW, so
+// removing a trivial phi updates every definition that referred to it.
+struct Variable final {
+  Symbol symbol = 0;
+  llvm::DenseMap<llvm::BasicBlock*, llvm::WeakTrackingVH> definitions;
+  // The numbers of the assignments to it, in the order they were lowered.
+  std::vector<std::size_t> writes;
+  // Arrays live in memory instead, in an alloca of the entry block.
+  llvm::AllocaInst* array = nullptr;
+};
+
+// Arrays are aligned to a cache line, which is also the width of the widest
+// vectors, so that vectorized loops over them never split an access.
+constexpr std::uint64_t kArrayAlignment = 64;
+
+// An instrumented function counts in a global array named after it, and main
+// calls the profile writer before it returns.
+constexpr std::string_view kCountersPrefix = "paraparacl.counters.";
+constexpr std::string_view kWriteProfile = "paraparacl.write_profile";
+// The functions of the program are prefixed in the module, so that their
+// names clash neither with main nor with the C library, whose memset,
+// fopen, and fprintf the generated code may call.
+constexpr std::string_view kFunctionPrefix = "paraparacl.function.";
+
+// A join whose phi waits for the values of a variable reaching it from its
+// predecessors while they're read.
+struct PendingPhi final {
+  llvm::BasicBlock* block;
+  llvm::PHINode* phi;
+  llvm::SmallVector<llvm::BasicBlock*, 2> preds;
+  std::size_t next_pred = 0;
+  // The blocks with a single predecessor that were passed on the way to the
+  // join, which take the value it ends up with.
+  llvm::SmallVector<llvm::BasicBlock*, 4> passed;
+};
+
+// The blocks an if or while statement branches to, the then and else arms or
+// the body and the exit of a loop. An instrumented function counts how often
+// each is entered from `counter` on, and for a loop, how often its guard
+// branches to each in the two counters after those, since the counts of the
+// guard and of the latch differ.
+struct Arms final {
+  llvm::BasicBlock* first;
+  llvm::BasicBlock* second;
+  std::uint64_t counter;
+  bool is_loop;
+  // The blocks of the guard of a loop, once it's lowered.
+  llvm::SmallVector<llvm::BasicBlock*, 2> guards;
+};
+
+// A join of an if or while statement that has been lowered. A variable that
+// none of the assignments numbered [first_write, end_write) of the statement
+// wrote reaches the join as it left `head`, the block the statement started
+// in, so reads go there instead of making a phi and visiting every arm.
+struct Join final {
+  llvm::BasicBlock* head;
+  std::size_t first_write;
+  std::size_t end_write;
+};
+
+// One step of lowering. A node is lowered by pushing the steps for its
+// children followed by the step that finishes it, so the AST is walked from
+// an explicit work stack, dispatching on node kinds, and the depth of the call
+// stack doesn't depend on the program. Expression steps push their results on
+// a stack of values, from which the finishing step of their parent pops them.
+struct Task final {
+  enum class Action : std::uint8_t {
+    // Lowers `stmts` until one of them terminates the block.
+    kStmts,
+    // Lowers the statement `node`.
+    kStmt,
+    // Pushes the value of the expression `node`; in a condition context,
+    // comparisons and logical operators push their i1 result instead.
+    kValue,
+    // Pushes the truth of the expression `node` as an i1.
+    kCondition,
+    kToCondition,
+    // Branches on the truth of the expression `node` to `first` if it holds
+    // and to `second` otherwise.
+    kBranch,
+    kCondBr,
+    // Seals `first` and `second`, if any, and continues in `first`.
+    kEnter,
+    // Continues in the body `first` of a loop, which stays unsealed until
+    // its latch is emitted, once the guard has branched to it or to the exit
+    // `second`.
+    kEnterLoop,
+    // The steps finishing a node after its children.
+    kAssign,
+    kStore,
+    kReturn,
+    kIfElse,
+    kIfEnd,
+    kWhileLatch,
+    kWhileEnd,
+    kBinary,
+    kLogical,
+    kShortCircuitRhs,
+    kShortCircuitEnd,
+    kUnary,
+    kCall,
+    kIndex,
+  };
+
+  Action action;
+  bool is_condition = false;
+  INode* node = nullptr;
+  StmtList stmts = {};
+  llvm::BasicBlock* first = nullptr;
+  llvm::BasicBlock* second = nullptr;
+};
+
+// Lowers the body of one function: main, whose statements may arrive in
+// parts, or a FunctionDef. Nothing is shared between two lowerings but the
+// symbols and the options, so functions in modules of different contexts can
+// be lowered on different threads.
+class FunctionLowering final {
  public:
-  Scope(Scope* const parent) noexcept : parent_(parent) {}
+  // Starts the body of the function with its entry block.
+  FunctionLowering(llvm::Function& function, const SymbolTable& symbols,
+                   const CodeGenOptions& options);
+
+  // Binds the parameters to the first slots, in order.
+  void BindParams(ParamList params);
+  void LowerStmts(StmtList stmts);
+  // Lowers a statement, or evaluates an expression, at the insert point.
+  void Lower(INode& node);
+  // Whether a path reaches the end of the statements lowered so far.
+  bool IsFallingThrough() const;
+  // Once the whole body is lowered, allocates the counters of an
+  // instrumented function and sets the counts of the profile, if any.
+  void Finish();
 
-  Scope* get_parent() noexcept { return parent_; }
-  const Scope* get_parent() const noexcept { return parent_; }
+ private:
+  // On-the-fly SSA construction over sealed blocks, after Braun et al.,
+  // "Simple and Efficient Construction of Static Single Assignment Form".
+  // A block is sealed once all of its predecessors are known; reads in
+  // unsealed blocks create incomplete phis that are finished on sealing.
+  // The paper's recursions over predecessors and phi users run on explicit
+  // stacks in the same order, so long chains of blocks can't overflow the
+  // call stack.
+  void WriteVariable(Slot slot, llvm::BasicBlock* block, llvm::Value* value);
+  llvm::Value* ReadVariable(Slot slot, llvm::BasicBlock* block);
+  // Returns the head of the join if the variable reaches it unchanged, and
+  // null otherwise.
+  llvm::BasicBlock* SkipJoin(Slot slot, llvm::BasicBlock* block) const;
+  llvm::PHINode* CreatePhi(Slot slot, llvm::BasicBlock* block);
+  llvm::Value* AddPhiOperands(Slot slot, llvm::PHINode* phi);
+  llvm::Value* TryRemoveTrivialPhi(llvm::PHINode* phi);
+  // Replaces the phi by its only operand and returns that, appending the phis
+  // that used it to `phi_users`, or returns null if the phi isn't trivial.
+  llvm::Value* RemoveTrivialPhi(llvm::PHINode* phi,
+                                std::vector<llvm::WeakVH>& phi_users);
+  void SealBlock(llvm::BasicBlock* block);
+  llvm::BasicBlock* CreateBlock(const std::string& name);
+
+  // Runs the work stack until it's empty.
+  void RunTasks();
+  void LowerStmts(const Task& task);
+  void LowerStmt(const Task& task);
+  void LowerValue(const Task& task);
+  // Schedules an expression for lowering, or lowers it right away if it's a
+  // leaf.
+  void LowerOperand(IExpr& expr);
+  // Pushes the value of a variable or number; returns false for operators.
+  bool LowerLeaf(IExpr& expr);
+  void LowerBranch(const Task& task);
+  void FinishIfElse(const Task& task);
+  void FinishIf(const Task& task);
+  void LowerLatch(const Task& task);
+  void FinishWhile(const Task& task);
+  void FinishBinary(const Task& task);
+  void FinishLogical(const Task& task);
+  void FinishShortCircuitLhs(const Task& task);
+  void FinishShortCircuit(const Task& task);
+  void FinishUnary(const Task& task);
+  void FinishCall(const Task& task);
+  void FinishStore(const Task& task);
+  void FinishIndex(const Task& task);
+  void LowerArrayDecl(const ArrayDeclStmt& stmt);
+  // Returns the address of an element of an array, branching to the trap
+  // block first unless the index is known to be in bounds.
+  llvm::Value* GetElement(Slot slot, std::int64_t length, llvm::Value* index);
+  // Divides or takes the remainder. With division checks, branches to the
+  // trap block first if the divisor may be zero, and dividing the least value
+  // by -1 wraps, as in the interpreter, where sdiv and srem would be
+  // undefined.
+  llvm::Value* LowerDivision(const BinaryExpr& expr, llvm::Value* lhs,
+                             llvm::Value* rhs);
+  // A block shared by all the bounds and division checks of the function
+  // that traps.
+  llvm::BasicBlock* GetTrapBlock();
+  // Tags the back edge of a loop with a loop ID, under which LLVM's loop
+  // passes record what they did to it, along with what the hints of the
+  // loop ask of them.
+  void SetLoopMetadata(llvm::Instruction& latch, const LoopHints& hints);
+  // Records the arms of an if or while statement and counts how often each
+  // is entered if the function is instrumented. The blocks must be empty.
+  void AddArms(llvm::BasicBlock* first, llvm::BasicBlock* second,
+               bool is_loop);
+  // Counts the branches of the guard of the last loop to its arms, which
+  // the guard blocks are the predecessors of so far.
+  void CountGuard();
+  void IncrementCounter(llvm::BasicBlock& block, std::uint64_t index);
+  // Adds the value, 0 or 1, to a counter at the insert point of the builder.
+  void AddToCounter(llvm::IRBuilder<>& builder, std::uint64_t index,
+                    llvm::Value* value);
+  // Sets the entry count of the function and the weights of the branches
+  // to the arms, unless the profile is of another version of the function.
+  void SetProfileCounts(const std::vector<std::uint64_t>& counts);
+
+  void PushTask(const Task& task);
+  void PushValue(llvm::Value* value);
+  llvm::Value* PopValue();
 
-  void Add(const std::string& name, llvm::AllocaInst* const alloc);
-  llvm::AllocaInst* Visible(const std::string& name) const;
-  llvm::AllocaInst* Find(const std::string& name) const;
+  llvm::Value* ToCondition(llvm::Value* value);
+  // In a condition context only the truth of an expression matters, so
+  // comparisons and logical operators yield their i1 result instead of
+  // widening it to a 0/1 i64 that would be compared against zero again.
+  llvm::Value* FinishCondition(llvm::Value* condition, bool is_condition,
+                               const std::string& name);
+  bool IsCurrentBlockTerminated() const;
 
  private:
-  Scope* parent_;
-  std::unordered_map<std::string, llvm::AllocaInst*> named_allocs_;
+  llvm::Function& function_;
+  llvm::LLVMContext& context_;
+  llvm::IRBuilder<> builder_;
+  std::vector<Task> tasks_;
+  std::vector<llvm::Value*> values_;
+  CodeGenOptions options_;
+
+  const SymbolTable& symbols_;
+  std::vector<Variable> variables_;
+  llvm::DenseSet<llvm::BasicBlock*> sealed_blocks_;
+  llvm::BasicBlock* trap_block_ = nullptr;
+  // For each loop being lowered, the blocks of its guard, which branch to its
+  // body or its exit before the first iteration and are left when the latch
+  // is tagged.
+  std::vector<llvm::SmallVector<llvm::BasicBlock*, 2>> loop_guards_;
+  std::vector<Arms> arms_;
+  // The entry count comes first.
+  std::uint64_t counter_count_ = 1;
+  // Stands in for the counters until their number is known.
+  llvm::GlobalVariable* counters_ = nullptr;
+  llvm::Function* write_profile_ = nullptr;
+  llvm::DenseMap<llvm::BasicBlock*,
+                 std::vector<std::pair<Slot, llvm::PHINode*>>>
+      incomplete_phis_;
+  std::size_t write_count_ = 0;
+  // For each if or while statement being lowered, the block it started in and
+  // the number of its first assignment.
+  std::vector<std::pair<llvm::BasicBlock*, std::size_t>> statements_;
+  llvm::DenseMap<llvm::BasicBlock*, Join> joins_;
 };
 
-void Scope::Add(const std::string& name, llvm::AllocaInst* const alloc) {
-  named_allocs_[name] = alloc;
+// Returns the function of the program with the symbol, declaring it in the
+// module if it isn't there yet. Functions take and return i64 values.
+llvm::Function* GetFunction(llvm::Module& module, const SymbolTable& symbols,
+                            const Symbol symbol, const std::size_t arity) {
+  auto* const i64 = llvm::Type::getInt64Ty(module.getContext());
+  auto* const type = llvm::FunctionType::get(
+      i64, llvm::SmallVector<llvm::Type*, 4>(arity, i64), false);
+  const auto name = std::string{kFunctionPrefix} +
+                    std::string{symbols.get_name(symbol)};
+  return llvm::cast<llvm::Function>(
+      module.getOrInsertFunction(name, type).getCallee());
+}
+
+// Returns the name of the function in the program, which profiles use.
+llvm::StringRef GetSourceName(const llvm::Function& function) {
+  auto name = function.getName();
+  name.consume_front(
+      llvm::StringRef{kFunctionPrefix.data(), kFunctionPrefix.size()});
+  return name;
 }
 
-llvm::AllocaInst* Scope::Visible(const std::string& name) const {
-  if (auto* const alloc = Find(name)) {
-    return alloc;
+// Calls `work` with every index below `count` on up to `jobs` threads, the
+// calling one included, and with the number of the thread, which is below
+// `jobs`. Once every index is done, the exception of the lowest index that
+// threw is rethrown, so the error reported doesn't depend on scheduling.
+void ParallelFor(const std::size_t count, const unsigned jobs,
+                 const llvm::function_ref<void(std::size_t, unsigned)> work) {
+  const auto threads =
+      static_cast<unsigned>(std::min<std::size_t>(jobs, count));
+  auto errors = std::vector<std::exception_ptr>(count);
+  auto next = std::atomic<std::size_t>{0};
+  const auto run = [&](const unsigned thread) {
+    for (auto i = next++; i < count; i = next++) {
+      try {
+        work(i, thread);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+
+  {
+    auto workers = std::vector<std::jthread>{};
+    for (auto thread = 1U; thread < threads; ++thread) {
+      workers.emplace_back(run, thread);
+    }
+    run(0);
+  }
+
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
   }
+}
+
+void RunPipeline(llvm::Module& module, const std::string_view pipeline,
+                 llvm::TargetMachine& target_machine,
+                 const llvm::PipelineTuningOptions& tuning) {
+  auto loop_analyses = llvm::LoopAnalysisManager{};
+  auto function_analyses = llvm::FunctionAnalysisManager{};
+  auto cgscc_analyses = llvm::CGSCCAnalysisManager{};
+  auto module_analyses = llvm::ModuleAnalysisManager{};
+
+  auto pass_builder = llvm::PassBuilder{&target_machine, tuning};
+  pass_builder.registerModuleAnalyses(module_analyses);
+  pass_builder.registerCGSCCAnalyses(cgscc_analyses);
+  pass_builder.registerFunctionAnalyses(function_analyses);
+  pass_builder.registerLoopAnalyses(loop_analyses);
+  pass_builder.crossRegisterProxies(loop_analyses, function_analyses,
+                                    cgscc_analyses, module_analyses);
+
+  auto passes = llvm::ModulePassManager{};
+  Check(pass_builder.parsePassPipeline(passes, pipeline));
+  passes.run(module, module_analyses);
+}
 
-  return parent_ ? parent_->Visible(name) : nullptr;
+// Scales the counts of two edges down to branch weights, which are 32 bits
+// wide, as clang does: both are divided so that the larger one fits, and one
+// is added so that an edge that was never taken still looks possible.
+llvm::MDNode* GetBranchWeights(llvm::LLVMContext& context,
+                               const std::uint64_t first,
+                               const std::uint64_t second) {
+  const auto scale =
+      std::max(first, second) / std::numeric_limits<std::uint32_t>::max() + 1;
+  return llvm::MDBuilder{context}.createBranchWeights(
+      static_cast<std::uint32_t>(first / scale + 1),
+      static_cast<std::uint32_t>(second / scale + 1));
 }
 
-llvm::AllocaInst* Scope::Find(const std::string& name) const {
-  if (const auto it = named_allocs_.find(name); it != named_allocs_.cend()) {
-    return it->second;
+// Returns the level of LLVM's default pipelines, "O1" to "O3", if that's
+// what the pipeline runs.
+std::optional<std::string> GetDefaultLevel(const std::string_view pipeline) {
+  for (const auto* const level : {"O1", "O2", "O3"}) {
+    if (pipeline == "default<" + std::string{level} + ">") {
+      return level;
+    }
   }
+  return std::nullopt;
+}
 
-  return nullptr;
+// Tunes the default pipelines as clang does: the loop and SLP vectorizers run
+// from -O2 on. Left to itself, PassBuilder doesn't run the SLP vectorizer.
+llvm::PipelineTuningOptions GetTuningOptions(
+    const std::optional<std::string>& level, const bool vectorize) {
+  auto tuning = llvm::PipelineTuningOptions{};
+  if (level) {
+    tuning.LoopVectorization = tuning.SLPVectorization =
+        vectorize && *level != "O1";
+  }
+  return tuning;
 }
 
 }  // namespace
 
+void WriteOutput(
+    const EmitKind kind, const std::string& filename,
+    const llvm::function_ref<void(llvm::raw_pwrite_stream&)> write) {
+  const auto is_binary =
+      kind == EmitKind::kBitcode || kind == EmitKind::kObject;
+
+  auto error = std::error_code{};
+  auto output = llvm::raw_fd_ostream{
+      filename, error,
+      is_binary ? llvm::sys::fs::OF_None : llvm::sys::fs::OF_Text};
+  if (error) {
+    throw std::runtime_error("Failed to open " + filename + ": " +
+                             error.message());
+  }
+  if (is_binary && output.is_displayed()) {
+    throw std::runtime_error(
+        "Refusing to write binary output to a terminal; use -o <file>");
+  }
+
+  write(output);
+
+  output.close();
+  if (output.has_error()) {
+    const auto message = output.error().message();
+    output.clear_error();
+    throw std::runtime_error("Failed to write " + filename + ": " + message);
+  }
+}
+
 class CodeGenerator::Impl final {
  public:
-  Impl();
+  Impl(const SymbolTable& symbols, Session& session,
+       const CodeGenOptions& options);
 
-  void Visit(CodeGenerator& visitor, Program& program);
-  void Visit(CodeGenerator& visitor, AssignStmt& stmt);
-  void Visit(CodeGenerator& visitor, IfStmt& stmt);
-  void Visit(CodeGenerator& visitor, WhileStmt& stmt);
-  void Visit(CodeGenerator& visitor, ReturnStmt& stmt);
-  void Visit(CodeGenerator& visitor, BinaryExpr& expr);
-  void Visit(CodeGenerator& visitor, UnaryExpr& expr);
-  void Visit(CodeGenerator& visitor, VarExpr& expr);
-  void Visit(CodeGenerator& visitor, NumberExpr& expr);
+  void Generate(Program& program);
+  void GenerateStmts(StmtList stmts);
+  void GenerateFunction(FunctionDef& def);
+  void FinishProgram();
+  void Lower(INode& node);
 
-  void Print();
+  void Optimize(std::string_view pipeline);
+  void Emit(EmitKind kind, const std::string& filename);
+  void Emit(EmitKind kind, llvm::raw_pwrite_stream& output);
+  OwnedModule TakeModule();
+  std::int64_t Run();
+
+  void set_statistics(Statistics* statistics) noexcept;
 
  private:
-  llvm::AllocaInst* CreateEntryBlockAlloca(const std::string& name);
-  llvm::Value* AcceptAndReturn(CodeGenerator& visitor, INode& node);
-  llvm::Value* ToCondition(llvm::Value* value);
-  bool IsCurrentBlockTerminated() const;
-  void VisitStatements(CodeGenerator& visitor,
-                       std::vector<std::unique_ptr<IStmt>>::iterator begin,
-                       std::vector<std::unique_ptr<IStmt>>::iterator end);
+  // A function of the program, lowered into a module and a context of its
+  // own so that it can be lowered and optimized on any thread. Units are
+  // linked into the module of main before it's emitted or run.
+  using Unit = OwnedModule;
+
+  Unit LowerFunction(FunctionDef& def) const;
+  // Links the units into the module in the order the functions were
+  // defined, so the module doesn't depend on the number of threads, and
+  // gives the functions of the program internal linkage: only main is
+  // called from outside, so the others can be dropped once inlined.
+  void Link();
+  // Defines the function an instrumented main calls before it returns, which
+  // writes the counters of every function to the profile, once the module
+  // holds all of them.
+  void DefineProfileWriter();
+  void CountModule();
 
  private:
+  Session& session_;
+  // Every compilation has a context of its own, so that the types and
+  // constants it creates go away with its module.
   std::unique_ptr<llvm::LLVMContext> context_;
   std::unique_ptr<llvm::Module> module_;
-  std::unique_ptr<llvm::IRBuilder<>> builder_;
-
-  llvm::Function* main_;
-  llvm::Value* return_ = nullptr;
+  std::optional<FunctionLowering> main_;
+  std::vector<Unit> units_;
+  CodeGenOptions options_;
+  Statistics* statistics_ = nullptr;
 
-  Scope* scope_ = nullptr;
+  const SymbolTable& symbols_;
 };
 
-CodeGenerator::Impl::Impl()
-    : context_(std::make_unique<llvm::LLVMContext>()),
+CodeGenerator::Impl::Impl(const SymbolTable& symbols, Session& session,
+                          const CodeGenOptions& options)
+    : session_(session),
+      context_(std::make_unique<llvm::LLVMContext>()),
       module_(std::make_unique<llvm::Module>("ParaParaCL", *context_)),
-      builder_(std::make_unique<llvm::IRBuilder<>>(*context_)) {
+      options_(options),
+      symbols_(symbols) {
   auto* const func_type =
       llvm::FunctionType::get(llvm::Type::getInt64Ty(*context_), false);
-  main_ = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage,
-                                 "main", module_.get());
+  auto* const main = llvm::Function::Create(
+      func_type, llvm::Function::ExternalLinkage, "main", module_.get());
+  if (options_.profile) {
+    options_.profile->AddSummary(*module_);
+  }
+  main_.emplace(*main, symbols_, options_);
+}
 
-  auto* const bb = llvm::BasicBlock::Create(*context_, "entry", main_);
-  builder_->SetInsertPoint(bb);
+void CodeGenerator::Impl::Generate(Program& program) {
+  const auto functions = program.get_functions();
+  {
+    // main is lowered in the code generator's own context by whichever
+    // thread gets to it first, and every function in a context of its own.
+    const auto region = TimePhase(statistics_, Phase::kCodegen);
+    auto units = std::vector<Unit>(functions.size());
+    ParallelFor(functions.size() + 1, options_.jobs,
+                [&](const std::size_t i, unsigned) {
+                  if (i == 0) {
+                    main_->LowerStmts(program.get_stmts());
+                  } else {
+                    units[i - 1] = LowerFunction(*functions[i - 1]);
+                  }
+                });
+    std::ranges::move(units, std::back_inserter(units_));
+  }
+  FinishProgram();
 }
 
-void CodeGenerator::Impl::Visit(CodeGenerator& visitor, Program& program) {
-  const auto scope = std::make_unique<Scope>(nullptr);
-  scope_ = scope.get();
+void CodeGenerator::Impl::GenerateStmts(const StmtList stmts) {
+  const auto region = TimePhase(statistics_, Phase::kCodegen);
+  main_->LowerStmts(stmts);
+}
 
-  VisitStatements(visitor, program.get_stmts_begin(), program.get_stmts_end());
+void CodeGenerator::Impl::GenerateFunction(FunctionDef& def) {
+  const auto region = TimePhase(statistics_, Phase::kCodegen);
+  units_.push_back(LowerFunction(def));
+}
 
-  if (builder_->GetInsertBlock() != nullptr && !IsCurrentBlockTerminated()) {
+void CodeGenerator::Impl::FinishProgram() {
+  if (main_->IsFallingThrough()) {
     throw std::runtime_error(
         "Reachable control-flow path falls through without return");
   }
+  main_->Finish();
 
-  if (llvm::verifyFunction(*main_, &llvm::errs())) {
+  const auto region = TimePhase(statistics_, Phase::kVerify);
+  if (llvm::verifyModule(*module_, &llvm::errs()) ||
+      std::ranges::any_of(units_, [](const Unit& unit) {
+        return llvm::verifyModule(*unit.module, &llvm::errs());
+      })) {
     throw std::runtime_error("LLVM function verification failed");
   }
 }
 
-void CodeGenerator::Impl::Visit(CodeGenerator& visitor, AssignStmt& stmt) {
-  auto* const rhs = AcceptAndReturn(visitor, stmt.get_expr());
+void CodeGenerator::Impl::Lower(INode& node) { main_->Lower(node); }
 
-  const auto& name = stmt.get_name();
-  auto* lhs = scope_->Visible(name);
-  if (!lhs) {
-    lhs = CreateEntryBlockAlloca(name);
-    scope_->Add(name, lhs);
+CodeGenerator::Impl::Unit CodeGenerator::Impl::LowerFunction(
+    FunctionDef& def) const {
+  auto context = std::make_unique<llvm::LLVMContext>();
+  const auto name = symbols_.get_name(def.get_symbol());
+  auto module = std::make_unique<llvm::Module>(
+      llvm::StringRef{name.data(), name.size()}, *context);
+  if (options_.profile) {
+    options_.profile->AddSummary(*module);
   }
 
-  builder_->CreateStore(rhs, lhs);
+  const auto params = def.get_params();
+  auto lowering = FunctionLowering{
+      *GetFunction(*module, symbols_, def.get_symbol(), params.size()),
+      symbols_, options_};
+  lowering.BindParams(params);
+  lowering.LowerStmts(def.get_stmts());
+  if (lowering.IsFallingThrough()) {
+    throw std::runtime_error("Reachable control-flow path of function " +
+                             std::string{name} +
+                             " falls through without return");
+  }
+  lowering.Finish();
+  return {std::move(context), std::move(module)};
 }
 
-void CodeGenerator::Impl::Visit(CodeGenerator& visitor, ReturnStmt& stmt) {
-  auto* const expr = AcceptAndReturn(visitor, stmt.get_expr());
-  builder_->CreateRet(expr);
+void CodeGenerator::Impl::Optimize(const std::string_view pipeline) {
+  const auto region = TimePhase(statistics_, Phase::kOptimize);
+  const auto level = GetDefaultLevel(pipeline);
+  const auto tuning = GetTuningOptions(level, options_.vectorize);
+  if (!units_.empty() && level) {
+    // Every module is optimized on its own first, in parallel, as LLVM does
+    // before link-time optimization, and the linked module again so that
+    // calls can be inlined. Target machines aren't thread-safe, so every
+    // thread gets one.
+    const auto module_count = units_.size() + 1;
+    auto target_machines =
+        std::vector<std::unique_ptr<llvm::TargetMachine>>{};
+    while (target_machines.size() < std::min<std::size_t>(options_.jobs,
+                                                          module_count)) {
+      target_machines.push_back(session_.CreateTargetMachine());
+    }
+    session_.Configure(*module_);
+    for (auto& unit : units_) {
+      session_.Configure(*unit.module);
+    }
+    ParallelFor(module_count, options_.jobs,
+                [&](const std::size_t i, const unsigned thread) {
+                  RunPipeline(i == 0 ? *module_ : *units_[i - 1].module,
+                              "lto-pre-link<" + *level + ">",
+                              *target_machines[thread], tuning);
+                });
+    Link();
+    RunPipeline(*module_, "lto<" + *level + ">",
+                session_.GetTargetMachine(), tuning);
+    return;
+  }
+
+  Link();
+  session_.Configure(*module_);
+  RunPipeline(*module_, pipeline, session_.GetTargetMachine(), tuning);
 }
 
-void CodeGenerator::Impl::Visit(CodeGenerator& visitor, IfStmt& stmt) {
-  auto* const cond = ToCondition(AcceptAndReturn(visitor, stmt.get_cond()));
-  auto* const then_bb = llvm::BasicBlock::Create(*context_, "then", main_);
-  auto* const else_bb = llvm::BasicBlock::Create(*context_, "else", main_);
-  builder_->CreateCondBr(cond, then_bb, else_bb);
+void CodeGenerator::Impl::Link() {
+  if (units_.empty()) {
+    DefineProfileWriter();
+    return;
+  }
 
-  llvm::BasicBlock* then_end = nullptr;
-  llvm::BasicBlock* else_end = nullptr;
+  // Modules of different contexts can't be linked directly, so every unit is
+  // written as bitcode, on its own thread, and read back into the context of
+  // main's module, which the code generator owns.
+  auto bitcode = std::vector<llvm::SmallVector<char, 0>>(units_.size());
+  ParallelFor(units_.size(), options_.jobs,
+              [&](const std::size_t i, unsigned) {
+                auto output = llvm::raw_svector_ostream{bitcode[i]};
+                llvm::WriteBitcodeToFile(*units_[i].module, output);
+                // The module must go before its context.
+                units_[i].module.reset();
+                units_[i].context.reset();
+              });
+  units_.clear();
+
+  auto linker = llvm::Linker{*module_};
+  for (const auto& unit : bitcode) {
+    auto module = Unwrap(llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef{llvm::StringRef{unit.data(), unit.size()},
+                              "function"},
+        *context_));
+    if (linker.linkInModule(std::move(module))) {
+      throw std::runtime_error("Failed to link the functions of the program");
+    }
+  }
 
-  {
-    const auto then_scope = std::make_unique<Scope>(scope_);
-    scope_ = then_scope.get();
-    builder_->SetInsertPoint(then_bb);
-    VisitStatements(visitor, stmt.get_then_begin(), stmt.get_then_end());
-    if (!IsCurrentBlockTerminated()) {
-      then_end = builder_->GetInsertBlock();
+  for (auto& function : *module_) {
+    if (!function.isDeclaration() && function.getName() != "main") {
+      function.setLinkage(llvm::GlobalValue::InternalLinkage);
     }
-    scope_ = scope_->get_parent();
   }
+  DefineProfileWriter();
+}
 
-  {
-    const auto else_scope = std::make_unique<Scope>(scope_);
-    scope_ = else_scope.get();
-    builder_->SetInsertPoint(else_bb);
-    VisitStatements(visitor, stmt.get_else_begin(), stmt.get_else_end());
-    if (!IsCurrentBlockTerminated()) {
-      else_end = builder_->GetInsertBlock();
+void CodeGenerator::Impl::DefineProfileWriter() {
+  auto* const writer =
+      module_->getFunction(llvm::StringRef{kWriteProfile.data(),
+                                           kWriteProfile.size()});
+  if (writer == nullptr || !writer->isDeclaration()) {
+    return;
+  }
+
+  // Only the writer reads the counters.
+  auto counters =
+      std::vector<std::pair<llvm::StringRef, llvm::GlobalVariable*>>{};
+  for (auto& global : module_->globals()) {
+    auto name = global.getName();
+    if (name.consume_front(llvm::StringRef{kCountersPrefix.data(),
+                                           kCountersPrefix.size()})) {
+      global.setLinkage(llvm::GlobalValue::InternalLinkage);
+      counters.emplace_back(name, &global);
     }
-    scope_ = scope_->get_parent();
   }
+  writer->setLinkage(llvm::GlobalValue::InternalLinkage);
+
+  // Every function is written as a line of its name and its counts. A
+  // profile that can't be opened is skipped, as the program's result
+  // matters more.
+  auto builder =
+      llvm::IRBuilder<>{llvm::BasicBlock::Create(*context_, "entry", writer)};
+  auto* const i64 = builder.getInt64Ty();
+  auto* const i32 = builder.getInt32Ty();
+  auto* const pointer = llvm::PointerType::getUnqual(builder.getInt8Ty());
+  const auto fopen = module_->getOrInsertFunction(
+      "fopen", llvm::FunctionType::get(pointer, {pointer, pointer}, false));
+  const auto fprintf = module_->getOrInsertFunction(
+      "fprintf", llvm::FunctionType::get(i32, {pointer, pointer}, true));
+  const auto fclose = module_->getOrInsertFunction(
+      "fclose", llvm::FunctionType::get(i32, {pointer}, false));
+
+  auto* const file = builder.CreateCall(
+      fopen,
+      {builder.CreateGlobalStringPtr(options_.instrument, "profile.path"),
+       builder.CreateGlobalStringPtr("w", "profile.mode")},
+      "file");
+  auto* const write_bb = llvm::BasicBlock::Create(*context_, "write", writer);
+  auto* const done_bb = llvm::BasicBlock::Create(*context_, "done", writer);
+  builder.CreateCondBr(builder.CreateIsNull(file), done_bb, write_bb);
+
+  builder.SetInsertPoint(write_bb);
+  auto* const count_format = builder.CreateGlobalStringPtr(" %lld");
+  auto* const end_format = builder.CreateGlobalStringPtr("\n");
+  for (const auto& [name, global] : counters) {
+    // Names are identifiers, which contain no conversions.
+    builder.CreateCall(fprintf, {file, builder.CreateGlobalStringPtr(name)});
+    const auto count =
+        llvm::cast<llvm::ArrayType>(global->getValueType())->getNumElements();
+    for (auto i = std::uint64_t{0}; i < count; ++i) {
+      auto* const counter = builder.CreateConstGEP2_64(
+          global->getValueType(), global, 0, i);
+      builder.CreateCall(
+          fprintf, {file, count_format,
+                    builder.CreateAlignedLoad(i64, counter, llvm::Align{8},
+                                              "count")});
+    }
+    builder.CreateCall(fprintf, {file, end_format});
+  }
+  builder.CreateCall(fclose, {file});
+  builder.CreateBr(done_bb);
 
-  if (then_end == nullptr && else_end == nullptr) {
-    builder_->ClearInsertionPoint();
+  builder.SetInsertPoint(done_bb);
+  builder.CreateRetVoid();
+}
+
+void CodeGenerator::Impl::Emit(const EmitKind kind,
+                               const std::string& filename) {
+  WriteOutput(kind, filename,
+              [&](llvm::raw_pwrite_stream& output) { Emit(kind, output); });
+}
+
+void CodeGenerator::Impl::Emit(const EmitKind kind,
+                               llvm::raw_pwrite_stream& output) {
+  const auto region = TimePhase(statistics_, Phase::kEmit);
+  Link();
+  session_.Configure(*module_);
+  CountModule();
+  const auto begin = output.tell();
+  switch (kind) {
+    case EmitKind::kIr: {
+      module_->print(output, nullptr);
+      break;
+    }
+    case EmitKind::kBitcode: {
+      llvm::WriteBitcodeToFile(*module_, output);
+      break;
+    }
+    case EmitKind::kAssembly:
+    case EmitKind::kObject: {
+      auto passes = llvm::legacy::PassManager{};
+      const auto file_type = kind == EmitKind::kObject
+                                 ? llvm::CodeGenFileType::ObjectFile
+                                 : llvm::CodeGenFileType::AssemblyFile;
+      if (session_.GetTargetMachine().addPassesToEmitFile(passes, output,
+                                                          nullptr, file_type)) {
+        throw std::runtime_error("The target can't emit this file type");
+      }
+      passes.run(*module_);
+      break;
+    }
+  }
+  if (statistics_ != nullptr) {
+    statistics_->get_counters().bytes_emitted = output.tell() - begin;
+  }
+}
+
+OwnedModule CodeGenerator::Impl::TakeModule() {
+  Link();
+  session_.Configure(*module_);
+  CountModule();
+  main_.reset();
+  return OwnedModule{.context = std::move(context_),
+                     .module = std::move(module_)};
+}
+
+std::int64_t CodeGenerator::Impl::Run() {
+  const auto region = TimePhase(statistics_, Phase::kRun);
+  return session_.Run(TakeModule());
+}
+
+void CodeGenerator::Impl::CountModule() {
+  if (statistics_ == nullptr) {
     return;
   }
 
-  auto* const cont_bb = llvm::BasicBlock::Create(*context_, "cont", main_);
-  if (then_end != nullptr) {
-    builder_->SetInsertPoint(then_end);
-    builder_->CreateBr(cont_bb);
+  auto& counters = statistics_->get_counters();
+  counters.basic_blocks = counters.instructions = counters.allocas = 0;
+  for (const auto& function : *module_) {
+    counters.basic_blocks += function.size();
+    for (const auto& block : function) {
+      counters.instructions += block.size();
+      for (const auto& instruction : block) {
+        counters.allocas += llvm::isa<llvm::AllocaInst>(instruction);
+      }
+    }
   }
-  if (else_end != nullptr) {
-    builder_->SetInsertPoint(else_end);
-    builder_->CreateBr(cont_bb);
+}
+
+void CodeGenerator::Impl::set_statistics(
+    Statistics* const statistics) noexcept {
+  statistics_ = statistics;
+}
+
+FunctionLowering::FunctionLowering(llvm::Function& function,
+                                   const SymbolTable& symbols,
+                                   const CodeGenOptions& options)
+    : function_(function),
+      context_(function.getContext()),
+      builder_(function.getContext()),
+      options_(options),
+      symbols_(symbols) {
+  auto* const bb = CreateBlock("entry");
+  SealBlock(bb);
+  builder_.SetInsertPoint(bb);
+
+  if (!options_.instrument.empty()) {
+    auto& module = *function.getParent();
+    counters_ = llvm::cast<llvm::GlobalVariable>(module.getOrInsertGlobal(
+        std::string{kCountersPrefix} + GetSourceName(function).str(),
+        builder_.getInt64Ty()));
+    IncrementCounter(*bb, 0);
+    if (function.getName() == "main") {
+      write_profile_ = llvm::Function::Create(
+          llvm::FunctionType::get(builder_.getVoidTy(), false),
+          llvm::Function::ExternalLinkage,
+          llvm::StringRef{kWriteProfile.data(), kWriteProfile.size()},
+          module);
+    }
   }
-  builder_->SetInsertPoint(cont_bb);
 }
 
-void CodeGenerator::Impl::Visit(CodeGenerator& visitor, WhileStmt& stmt) {
-  auto* const while_bb = llvm::BasicBlock::Create(*context_, "while", main_);
+void FunctionLowering::BindParams(const ParamList params) {
+  variables_.resize(std::max(variables_.size(), params.size()));
+  for (auto slot = Slot{0}; slot < params.size(); ++slot) {
+    auto* const arg = function_.getArg(slot);
+    const auto name = symbols_.get_name(params[slot]);
+    arg->setName(llvm::StringRef{name.data(), name.size()});
+    variables_[slot].symbol = params[slot];
+    WriteVariable(slot, &function_.getEntryBlock(), arg);
+  }
+}
 
-  builder_->CreateBr(while_bb);
-  builder_->SetInsertPoint(while_bb);
+void FunctionLowering::LowerStmts(const StmtList stmts) {
+  PushTask({.action = Task::Action::kStmts, .stmts = stmts});
+  RunTasks();
+}
 
-  auto* const cond = ToCondition(AcceptAndReturn(visitor, stmt.get_cond()));
-  auto* const do_bb = llvm::BasicBlock::Create(*context_, "do", main_);
-  auto* const cont_bb = llvm::BasicBlock::Create(*context_, "cont", main_);
+bool FunctionLowering::IsFallingThrough() const {
+  return builder_.GetInsertBlock() != nullptr && !IsCurrentBlockTerminated();
+}
 
-  builder_->CreateCondBr(cond, do_bb, cont_bb);
+void FunctionLowering::Finish() {
+  if (counters_ != nullptr) {
+    const auto name = counters_->getName().str();
+    counters_->setName("");
+    auto* const type =
+        llvm::ArrayType::get(builder_.getInt64Ty(), counter_count_);
+    auto* const counters = llvm::cast<llvm::GlobalVariable>(
+        function_.getParent()->getOrInsertGlobal(name, type));
+    counters->setInitializer(llvm::ConstantAggregateZero::get(type));
+    counters->setAlignment(llvm::Align{8});
+    counters_->replaceAllUsesWith(
+        llvm::ConstantExpr::getPointerCast(counters, counters_->getType()));
+    counters_->eraseFromParent();
+    counters_ = nullptr;
+  }
 
-  {
-    const auto do_scope = std::make_unique<Scope>(scope_);
-    scope_ = do_scope.get();
+  if (options_.profile) {
+    const auto name = GetSourceName(function_);
+    if (const auto* const counts = options_.profile->Find(
+            std::string_view{name.data(), name.size()})) {
+      SetProfileCounts(*counts);
+    }
+  }
+
+  // The definitions are done with, and their handles would otherwise follow
+  // every value that folding the arms replaces.
+  variables_.clear();
+  // Last, since it may delete the blocks of arms that are never taken.
+  PropagateRanges(function_);
+}
+
+void FunctionLowering::Lower(INode& node) {
+  const auto action = llvm::isa<IExpr>(node) ? Task::Action::kValue
+                                             : Task::Action::kStmt;
+  PushTask({.action = action, .node = &node});
+  RunTasks();
+  values_.clear();
+}
+
+void FunctionLowering::RunTasks() {
+  while (!tasks_.empty()) {
+    const auto task = tasks_.back();
+    tasks_.pop_back();
+    switch (task.action) {
+      using enum Task::Action;
+      case kStmts: {
+        LowerStmts(task);
+        break;
+      }
+      case kStmt: {
+        LowerStmt(task);
+        break;
+      }
+      case kValue: {
+        LowerValue(task);
+        break;
+      }
+      case kCondition: {
+        PushTask({.action = kToCondition});
+        PushTask({.action = kValue, .is_condition = true, .node = task.node});
+        break;
+      }
+      case kToCondition: {
+        auto* const value = PopValue();
+        PushValue(value->getType()->isIntegerTy(1) ? value
+                                                   : ToCondition(value));
+        break;
+      }
+      case kBranch: {
+        LowerBranch(task);
+        break;
+      }
+      case kCondBr: {
+        builder_.CreateCondBr(PopValue(), task.first, task.second);
+        break;
+      }
+      case kEnter: {
+        SealBlock(task.first);
+        if (task.second != nullptr) {
+          SealBlock(task.second);
+        }
+        builder_.SetInsertPoint(task.first);
+        break;
+      }
+      case kEnterLoop: {
+        const auto preds = llvm::predecessors(task.first);
+        loop_guards_.emplace_back(preds.begin(), preds.end());
+        for (auto* const pred : llvm::predecessors(task.second)) {
+          if (!llvm::is_contained(loop_guards_.back(), pred)) {
+            loop_guards_.back().push_back(pred);
+          }
+        }
+        arms_.back().guards = loop_guards_.back();
+        if (counters_ != nullptr) {
+          CountGuard();
+        }
+        builder_.SetInsertPoint(task.first);
+        break;
+      }
+      case kAssign: {
+        auto& stmt = *llvm::cast<AssignStmt>(task.node);
+        const auto slot = stmt.get_slot();
+        if (slot >= variables_.size()) {
+          variables_.resize(slot + 1);
+        }
+        variables_[slot].symbol = stmt.get_symbol();
+        variables_[slot].writes.push_back(write_count_++);
+        WriteVariable(slot, builder_.GetInsertBlock(), PopValue());
+        break;
+      }
+      case kStore: {
+        FinishStore(task);
+        break;
+      }
+      case kReturn: {
+        auto* const value = PopValue();
+        if (write_profile_ != nullptr) {
+          builder_.CreateCall(write_profile_);
+        }
+        builder_.CreateRet(value);
+        break;
+      }
+      case kIfElse: {
+        FinishIfElse(task);
+        break;
+      }
+      case kIfEnd: {
+        FinishIf(task);
+        break;
+      }
+      case kWhileLatch: {
+        LowerLatch(task);
+        break;
+      }
+      case kWhileEnd: {
+        FinishWhile(task);
+        break;
+      }
+      case kBinary: {
+        FinishBinary(task);
+        break;
+      }
+      case kLogical: {
+        FinishLogical(task);
+        break;
+      }
+      case kShortCircuitRhs: {
+        FinishShortCircuitLhs(task);
+        break;
+      }
+      case kShortCircuitEnd: {
+        FinishShortCircuit(task);
+        break;
+      }
+      case kUnary: {
+        FinishUnary(task);
+        break;
+      }
+      case kCall: {
+        FinishCall(task);
+        break;
+      }
+      case kIndex: {
+        FinishIndex(task);
+        break;
+      }
+    }
+  }
+}
+
+void FunctionLowering::LowerStmts(const Task& task) {
+  if (task.stmts.empty() || IsCurrentBlockTerminated()) {
+    return;
+  }
+
+  PushTask({.action = Task::Action::kStmts, .stmts = task.stmts.subspan(1)});
+  LowerStmt({.action = Task::Action::kStmt, .node = task.stmts.front()});
+}
 
-    builder_->SetInsertPoint(do_bb);
-    VisitStatements(visitor, stmt.get_stmts_begin(), stmt.get_stmts_end());
-    if (!IsCurrentBlockTerminated()) {
-      builder_->CreateBr(while_bb);
+void FunctionLowering::LowerStmt(const Task& task) {
+  switch (task.node->get_kind()) {
+    using Action = Task::Action;
+    case NodeKind::kAssignStmt: {
+      auto& stmt = *llvm::cast<AssignStmt>(task.node);
+      PushTask({.action = Action::kAssign, .node = &stmt});
+      LowerOperand(stmt.get_expr());
+      break;
+    }
+    case NodeKind::kStoreStmt: {
+      // The index is evaluated before the value.
+      auto& stmt = *llvm::cast<StoreStmt>(task.node);
+      PushTask({.action = Action::kStore, .node = &stmt});
+      PushTask({.action = Action::kValue, .node = &stmt.get_expr()});
+      LowerOperand(stmt.get_index());
+      break;
+    }
+    case NodeKind::kArrayDeclStmt: {
+      LowerArrayDecl(*llvm::cast<ArrayDeclStmt>(task.node));
+      break;
     }
+    case NodeKind::kReturnStmt: {
+      auto& stmt = *llvm::cast<ReturnStmt>(task.node);
+      PushTask({.action = Action::kReturn, .node = &stmt});
+      LowerOperand(stmt.get_expr());
+      break;
+    }
+    case NodeKind::kIfStmt: {
+      auto& stmt = *llvm::cast<IfStmt>(task.node);
+      statements_.emplace_back(builder_.GetInsertBlock(), write_count_);
+      auto* const then_bb = CreateBlock("then");
+      auto* const else_bb = CreateBlock("else");
+      AddArms(then_bb, else_bb, /*is_loop=*/false);
+      PushTask({.action = Action::kIfElse, .node = &stmt, .first = else_bb});
+      PushTask({.action = Action::kStmts, .stmts = stmt.get_then_stmts()});
+      PushTask(
+          {.action = Action::kEnter, .first = then_bb, .second = else_bb});
+      PushTask({.action = Action::kBranch,
+                .node = &stmt.get_cond(),
+                .first = then_bb,
+                .second = else_bb});
+      break;
+    }
+    case NodeKind::kWhileStmt: {
+      // Loops are rotated as LLVM's passes expect them: the condition is
+      // tested once before the body, as a guard, and then at its end, so
+      // every iteration takes a single branch, back from the latch.
+      auto& stmt = *llvm::cast<WhileStmt>(task.node);
+      statements_.emplace_back(builder_.GetInsertBlock(), write_count_);
+      auto* const do_bb = CreateBlock("do");
+      auto* const cont_bb = CreateBlock("cont");
+      AddArms(do_bb, cont_bb, /*is_loop=*/true);
+      PushTask({.action = Action::kWhileLatch,
+                .node = &stmt,
+                .first = do_bb,
+                .second = cont_bb});
+      PushTask({.action = Action::kStmts, .stmts = stmt.get_stmts()});
+      PushTask(
+          {.action = Action::kEnterLoop, .first = do_bb, .second = cont_bb});
+      PushTask({.action = Action::kBranch,
+                .node = &stmt.get_cond(),
+                .first = do_bb,
+                .second = cont_bb});
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
 
-    scope_ = scope_->get_parent();
+void FunctionLowering::LowerValue(const Task& task) {
+  switch (task.node->get_kind()) {
+    using Action = Task::Action;
+    case NodeKind::kBinaryExpr: {
+      auto& expr = *llvm::cast<BinaryExpr>(task.node);
+      const auto op = expr.get_op();
+      if (op == BinaryExpr::Op::kAnd || op == BinaryExpr::Op::kOr) {
+        if (options_.short_circuit) {
+          const auto is_and = op == BinaryExpr::Op::kAnd;
+          auto* const rhs_bb = CreateBlock(is_and ? "and.rhs" : "or.rhs");
+          auto* const end_bb = CreateBlock(is_and ? "and.end" : "or.end");
+          PushTask({.action = Action::kShortCircuitRhs,
+                    .is_condition = task.is_condition,
+                    .node = &expr,
+                    .first = rhs_bb,
+                    .second = end_bb});
+        } else {
+          PushTask({.action = Action::kLogical,
+                    .is_condition = task.is_condition,
+                    .node = &expr});
+          PushTask({.action = Action::kCondition, .node = &expr.get_rhs()});
+        }
+        PushTask({.action = Action::kCondition, .node = &expr.get_lhs()});
+        break;
+      }
+
+      // A leaf operand is lowered right away; the right one waits until the
+      // left one has been lowered.
+      PushTask({.action = Action::kBinary,
+                .is_condition = task.is_condition,
+                .node = &expr});
+      if (!LowerLeaf(expr.get_lhs())) {
+        PushTask({.action = Action::kValue, .node = &expr.get_rhs()});
+        PushTask({.action = Action::kValue, .node = &expr.get_lhs()});
+      } else {
+        LowerOperand(expr.get_rhs());
+      }
+      break;
+    }
+    case NodeKind::kUnaryExpr: {
+      auto& expr = *llvm::cast<UnaryExpr>(task.node);
+      PushTask({.action = Action::kUnary,
+                .is_condition = task.is_condition,
+                .node = &expr});
+      if (expr.get_op() == UnaryExpr::Op::kNot) {
+        PushTask({.action = Action::kCondition, .node = &expr.get_expr()});
+      } else {
+        LowerOperand(expr.get_expr());
+      }
+      break;
+    }
+    case NodeKind::kCallExpr: {
+      auto& expr = *llvm::cast<CallExpr>(task.node);
+      const auto args = expr.get_args();
+      PushTask({.action = Action::kCall, .node = &expr});
+      for (auto it = args.rbegin(); it != args.rend(); ++it) {
+        PushTask({.action = Action::kValue, .node = *it});
+      }
+      break;
+    }
+    case NodeKind::kIndexExpr: {
+      auto& expr = *llvm::cast<IndexExpr>(task.node);
+      PushTask({.action = Action::kIndex, .node = &expr});
+      LowerOperand(expr.get_index());
+      break;
+    }
+    default: {
+      LowerLeaf(*llvm::cast<IExpr>(task.node));
+      break;
+    }
+  }
+}
+
+void FunctionLowering::LowerOperand(IExpr& expr) {
+  if (!LowerLeaf(expr)) {
+    PushTask({.action = Task::Action::kValue, .node = &expr});
   }
+}
 
-  builder_->SetInsertPoint(cont_bb);
+bool FunctionLowering::LowerLeaf(IExpr& expr) {
+  switch (expr.get_kind()) {
+    case NodeKind::kVarExpr: {
+      PushValue(ReadVariable(llvm::cast<VarExpr>(expr).get_slot(),
+                             builder_.GetInsertBlock()));
+      return true;
+    }
+    case NodeKind::kNumberExpr: {
+      PushValue(llvm::ConstantInt::get(
+          context_,
+          llvm::APInt(64, llvm::cast<NumberExpr>(expr).get_value(), true)));
+      return true;
+    }
+    case NodeKind::kLengthExpr: {
+      PushValue(builder_.getInt64(llvm::cast<LengthExpr>(expr).get_length()));
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
 }
 
-void CodeGenerator::Impl::Visit(CodeGenerator& visitor, BinaryExpr& expr) {
-  auto* const lhs = AcceptAndReturn(visitor, expr.get_lhs());
-  auto* const rhs = AcceptAndReturn(visitor, expr.get_rhs());
+// With short-circuit evaluation, && and || become branches themselves and
+// their right operand is only evaluated when it decides the result.
+void FunctionLowering::LowerBranch(const Task& task) {
+  using Action = Task::Action;
+  auto* const true_bb = task.first;
+  auto* const false_bb = task.second;
+
+  auto* const binary = llvm::dyn_cast<BinaryExpr>(task.node);
+  if (options_.short_circuit && binary != nullptr &&
+      (binary->get_op() == BinaryExpr::Op::kAnd ||
+       binary->get_op() == BinaryExpr::Op::kOr)) {
+    const auto is_and = binary->get_op() == BinaryExpr::Op::kAnd;
+    auto* const rhs_bb = CreateBlock(is_and ? "and.rhs" : "or.rhs");
+    PushTask({.action = Action::kBranch,
+              .node = &binary->get_rhs(),
+              .first = true_bb,
+              .second = false_bb});
+    PushTask({.action = Action::kEnter, .first = rhs_bb});
+    PushTask({.action = Action::kBranch,
+              .node = &binary->get_lhs(),
+              .first = is_and ? rhs_bb : true_bb,
+              .second = is_and ? false_bb : rhs_bb});
+    return;
+  }
 
-  switch (expr.get_op()) {
+  auto* const unary = llvm::dyn_cast<UnaryExpr>(task.node);
+  if (unary != nullptr && unary->get_op() == UnaryExpr::Op::kNot) {
+    PushTask({.action = Action::kBranch,
+              .node = &unary->get_expr(),
+              .first = false_bb,
+              .second = true_bb});
+    return;
+  }
+
+  PushTask({.action = Action::kCondBr, .first = true_bb, .second = false_bb});
+  PushTask({.action = Action::kCondition, .node = task.node});
+}
+
+void FunctionLowering::FinishIfElse(const Task& task) {
+  auto* const then_end =
+      IsCurrentBlockTerminated() ? nullptr : builder_.GetInsertBlock();
+  builder_.SetInsertPoint(task.first);
+  PushTask({.action = Task::Action::kIfEnd, .first = then_end});
+  PushTask({.action = Task::Action::kStmts,
+            .stmts = llvm::cast<IfStmt>(task.node)->get_else_stmts()});
+}
+
+void FunctionLowering::FinishIf(const Task& task) {
+  const auto [head, first_write] = statements_.back();
+  statements_.pop_back();
+  auto* const then_end = task.first;
+  auto* const else_end =
+      IsCurrentBlockTerminated() ? nullptr : builder_.GetInsertBlock();
+  if (then_end == nullptr && else_end == nullptr) {
+    builder_.ClearInsertionPoint();
+    return;
+  }
+
+  auto* const cont_bb = CreateBlock("cont");
+  if (then_end != nullptr) {
+    builder_.SetInsertPoint(then_end);
+    builder_.CreateBr(cont_bb);
+  }
+  if (else_end != nullptr) {
+    builder_.SetInsertPoint(else_end);
+    builder_.CreateBr(cont_bb);
+  }
+  joins_[cont_bb] = {head, first_write, write_count_};
+  SealBlock(cont_bb);
+  builder_.SetInsertPoint(cont_bb);
+}
+
+void FunctionLowering::LowerLatch(const Task& task) {
+  if (IsCurrentBlockTerminated()) {
+    FinishWhile(task);
+    return;
+  }
+
+  PushTask({.action = Task::Action::kWhileEnd,
+            .node = task.node,
+            .first = task.first,
+            .second = task.second});
+  PushTask({.action = Task::Action::kBranch,
+            .node = &llvm::cast<WhileStmt>(task.node)->get_cond(),
+            .first = task.first,
+            .second = task.second});
+}
+
+void FunctionLowering::FinishWhile(const Task& task) {
+  auto* const do_bb = task.first;
+  const auto guards = std::move(loop_guards_.back());
+  loop_guards_.pop_back();
+  // The condition may branch back from several blocks, which LLVM merges
+  // into one latch; they share the loop ID.
+  auto* loop_id = static_cast<llvm::MDNode*>(nullptr);
+  for (auto* const pred : llvm::predecessors(do_bb)) {
+    if (llvm::is_contained(guards, pred)) {
+      continue;
+    }
+    auto& latch = *pred->getTerminator();
+    if (loop_id == nullptr) {
+      SetLoopMetadata(latch, llvm::cast<WhileStmt>(task.node)->get_hints());
+      loop_id = latch.getMetadata(llvm::LLVMContext::MD_loop);
+    } else {
+      latch.setMetadata(llvm::LLVMContext::MD_loop, loop_id);
+    }
+  }
+
+  const auto [head, first_write] = statements_.back();
+  statements_.pop_back();
+  joins_[do_bb] = {head, first_write, write_count_};
+  joins_[task.second] = {head, first_write, write_count_};
+  SealBlock(do_bb);
+  SealBlock(task.second);
+  builder_.SetInsertPoint(task.second);
+}
+
+void FunctionLowering::FinishBinary(const Task& task) {
+  auto* const rhs = PopValue();
+  auto* const lhs = PopValue();
+  const auto is_condition = task.is_condition;
+
+  auto* result = static_cast<llvm::Value*>(nullptr);
+  switch (llvm::cast<BinaryExpr>(task.node)->get_op()) {
     using enum BinaryExpr::Op;
     case kAdd: {
-      return_ = builder_->CreateAdd(lhs, rhs, "addtmp");
+      result = builder_.CreateAdd(lhs, rhs, "addtmp");
       break;
     }
     case kSub: {
-      return_ = builder_->CreateSub(lhs, rhs, "subtmp");
+      result = builder_.CreateSub(lhs, rhs, "subtmp");
       break;
     }
     case kMul: {
-      return_ = builder_->CreateMul(lhs, rhs, "multmp");
-      break;
-    }
-    case kDiv: {
-      return_ = builder_->CreateSDiv(lhs, rhs, "divtmp");
+      result = builder_.CreateMul(lhs, rhs, "multmp");
       break;
     }
+    case kDiv:
     case kMod: {
-      return_ = builder_->CreateSRem(lhs, rhs, "modtmp");
+      result = LowerDivision(*llvm::cast<BinaryExpr>(task.node), lhs, rhs);
       break;
     }
     case kEq: {
-      return_ =
-          builder_->CreateZExt(builder_->CreateICmpEQ(lhs, rhs, "eqtmp"),
-                               llvm::Type::getInt64Ty(*context_), "eqvalue");
+      result = FinishCondition(builder_.CreateICmpEQ(lhs, rhs, "eqtmp"),
+                               is_condition, "eqvalue");
       break;
     }
     case kNe: {
-      return_ =
-          builder_->CreateZExt(builder_->CreateICmpNE(lhs, rhs, "netmp"),
-                               llvm::Type::getInt64Ty(*context_), "nevalue");
+      result = FinishCondition(builder_.CreateICmpNE(lhs, rhs, "netmp"),
+                               is_condition, "nevalue");
       break;
     }
     case kLt: {
-      return_ =
-          builder_->CreateZExt(builder_->CreateICmpSLT(lhs, rhs, "lttmp"),
-                               llvm::Type::getInt64Ty(*context_), "ltvalue");
+      result = FinishCondition(builder_.CreateICmpSLT(lhs, rhs, "lttmp"),
+                               is_condition, "ltvalue");
       break;
     }
     case kGt: {
-      return_ =
-          builder_->CreateZExt(builder_->CreateICmpSGT(lhs, rhs, "gttmp"),
-                               llvm::Type::getInt64Ty(*context_), "gtvalue");
+      result = FinishCondition(builder_.CreateICmpSGT(lhs, rhs, "gttmp"),
+                               is_condition, "gtvalue");
       break;
     }
     case kLe: {
-      return_ =
-          builder_->CreateZExt(builder_->CreateICmpSLE(lhs, rhs, "letmp"),
-                               llvm::Type::getInt64Ty(*context_), "levalue");
+      result = FinishCondition(builder_.CreateICmpSLE(lhs, rhs, "letmp"),
+                               is_condition, "levalue");
       break;
     }
     case kGe: {
-      return_ =
-          builder_->CreateZExt(builder_->CreateICmpSGE(lhs, rhs, "getmp"),
-                               llvm::Type::getInt64Ty(*context_), "gevalue");
-      break;
-    }
-    case kAnd: {
-      return_ = builder_->CreateZExt(
-          builder_->CreateAnd(ToCondition(lhs), ToCondition(rhs), "andtmp"),
-          llvm::Type::getInt64Ty(*context_), "andvalue");
+      result = FinishCondition(builder_.CreateICmpSGE(lhs, rhs, "getmp"),
+                               is_condition, "gevalue");
       break;
     }
+    case kAnd:
     case kOr: {
-      return_ = builder_->CreateZExt(
-          builder_->CreateOr(ToCondition(lhs), ToCondition(rhs), "ortmp"),
-          llvm::Type::getInt64Ty(*context_), "orvalue");
       break;
     }
   }
+  PushValue(result);
+}
+
+void FunctionLowering::FinishLogical(const Task& task) {
+  auto* const rhs = PopValue();
+  auto* const lhs = PopValue();
+  const auto is_and =
+      llvm::cast<BinaryExpr>(task.node)->get_op() == BinaryExpr::Op::kAnd;
+  auto* const condition = is_and ? builder_.CreateAnd(lhs, rhs, "andtmp")
+                                 : builder_.CreateOr(lhs, rhs, "ortmp");
+  PushValue(FinishCondition(condition, task.is_condition,
+                            is_and ? "andvalue" : "orvalue"));
+}
+
+void FunctionLowering::FinishShortCircuitLhs(const Task& task) {
+  auto& expr = *llvm::cast<BinaryExpr>(task.node);
+  const auto is_and = expr.get_op() == BinaryExpr::Op::kAnd;
+  auto* const rhs_bb = task.first;
+  auto* const end_bb = task.second;
+
+  // The right operand decides the result only if the left one is true for
+  // && and false for ||; otherwise the left one does.
+  auto* const lhs = PopValue();
+  auto* const lhs_end = builder_.GetInsertBlock();
+  if (is_and) {
+    builder_.CreateCondBr(lhs, rhs_bb, end_bb);
+  } else {
+    builder_.CreateCondBr(lhs, end_bb, rhs_bb);
+  }
+  SealBlock(rhs_bb);
+
+  builder_.SetInsertPoint(rhs_bb);
+  PushTask({.action = Task::Action::kShortCircuitEnd,
+            .is_condition = task.is_condition,
+            .node = &expr,
+            .first = end_bb,
+            .second = lhs_end});
+  PushTask({.action = Task::Action::kCondition, .node = &expr.get_rhs()});
 }
 
-void CodeGenerator::Impl::Visit(CodeGenerator& visitor, UnaryExpr& expr) {
-  auto* const value = AcceptAndReturn(visitor, expr.get_expr());
+void FunctionLowering::FinishShortCircuit(const Task& task) {
+  const auto is_and =
+      llvm::cast<BinaryExpr>(task.node)->get_op() == BinaryExpr::Op::kAnd;
+  auto* const end_bb = task.first;
+  auto* const lhs_end = task.second;
+
+  auto* const rhs = PopValue();
+  auto* const rhs_end = builder_.GetInsertBlock();
+  builder_.CreateBr(end_bb);
+  SealBlock(end_bb);
+
+  builder_.SetInsertPoint(end_bb);
+  auto* const phi = builder_.CreatePHI(llvm::Type::getInt1Ty(context_), 2,
+                                        is_and ? "andtmp" : "ortmp");
+  phi->addIncoming(builder_.getInt1(!is_and), lhs_end);
+  phi->addIncoming(rhs, rhs_end);
+  PushValue(FinishCondition(phi, task.is_condition,
+                            is_and ? "andvalue" : "orvalue"));
+}
 
-  switch (expr.get_op()) {
+void FunctionLowering::FinishUnary(const Task& task) {
+  switch (llvm::cast<UnaryExpr>(task.node)->get_op()) {
     using enum UnaryExpr::Op;
     case kNeg: {
-      return_ = builder_->CreateNeg(value, "negtmp");
+      PushValue(builder_.CreateNeg(PopValue(), "negtmp"));
       break;
     }
     case kNot: {
-      return_ = builder_->CreateZExt(
-          builder_->CreateICmpEQ(
-              value, llvm::ConstantInt::get(value->getType(), 0), "nottmp"),
-          llvm::Type::getInt64Ty(*context_), "notvalue");
+      // A comparison that was just created is inverted in place.
+      auto* const condition = PopValue();
+      auto* const compare = llvm::dyn_cast<llvm::ICmpInst>(condition);
+      if (compare != nullptr && compare->use_empty()) {
+        compare->setPredicate(compare->getInversePredicate());
+        PushValue(FinishCondition(compare, task.is_condition, "notvalue"));
+      } else {
+        PushValue(FinishCondition(builder_.CreateNot(condition, "nottmp"),
+                                  task.is_condition, "notvalue"));
+      }
       break;
     }
   }
 }
 
-void CodeGenerator::Impl::Visit([[maybe_unused]] CodeGenerator& visitor,
-                                VarExpr& expr) {
-  const auto& name = expr.get_name();
+void FunctionLowering::FinishCall(const Task& task) {
+  auto& expr = *llvm::cast<CallExpr>(task.node);
+  const auto arg_count = expr.get_args().size();
+  auto* const callee = GetFunction(*function_.getParent(), symbols_,
+                                   expr.get_symbol(), arg_count);
+  const auto args =
+      llvm::ArrayRef<llvm::Value*>{values_}.take_back(arg_count);
+  auto* const call = builder_.CreateCall(callee, args, "calltmp");
+  values_.resize(values_.size() - arg_count);
+  PushValue(call);
+}
+
+void FunctionLowering::FinishStore(const Task& task) {
+  auto& stmt = *llvm::cast<StoreStmt>(task.node);
+  auto* const value = PopValue();
+  auto* const index = PopValue();
+  auto* const element =
+      GetElement(stmt.get_slot(), stmt.get_length(), index);
+  builder_.CreateAlignedStore(value, element, llvm::Align{8});
+}
+
+void FunctionLowering::FinishIndex(const Task& task) {
+  auto& expr = *llvm::cast<IndexExpr>(task.node);
+  auto* const element =
+      GetElement(expr.get_slot(), expr.get_length(), PopValue());
+  PushValue(builder_.CreateAlignedLoad(builder_.getInt64Ty(), element,
+                                       llvm::Align{8}, "elemtmp"));
+}
+
+void FunctionLowering::LowerArrayDecl(const ArrayDeclStmt& stmt) {
+  const auto slot = stmt.get_slot();
+  if (slot >= variables_.size()) {
+    variables_.resize(slot + 1);
+  }
+  auto& variable = variables_[slot];
+  variable.symbol = stmt.get_symbol();
+
+  // The storage is allocated once, in the entry block, so that it's a
+  // static alloca however often the declaration runs.
+  const auto length = stmt.get_length();
+  if (variable.array == nullptr) {
+    auto& entry = function_.getEntryBlock();
+    auto builder = llvm::IRBuilder<>{&entry, entry.begin()};
+    const auto name = symbols_.get_name(variable.symbol);
+    variable.array = builder.CreateAlloca(
+        llvm::ArrayType::get(builder.getInt64Ty(), length), nullptr,
+        llvm::StringRef{name.data(), name.size()});
+    variable.array->setAlignment(llvm::Align{kArrayAlignment});
+  }
+  builder_.CreateMemSet(variable.array, builder_.getInt8(0),
+                        builder_.getInt64(length * 8),
+                        llvm::Align{kArrayAlignment});
+}
 
-  auto* const alloc = scope_->Visible(name);
-  if (!alloc) {
-    throw std::runtime_error("Unknown variable " + name);
+llvm::Value* FunctionLowering::GetElement(const Slot slot,
+                                          const std::int64_t length,
+                                          llvm::Value* const index) {
+  const auto* const constant = llvm::dyn_cast<llvm::ConstantInt>(index);
+  if (constant == nullptr || constant->getValue().uge(length)) {
+    // A negative index is a large unsigned one, so one comparison checks
+    // both bounds.
+    auto* const in_bounds = builder_.CreateICmpULT(
+        index, builder_.getInt64(length), "inbounds");
+    auto* const element_bb = CreateBlock("element");
+    builder_.CreateCondBr(in_bounds, element_bb, GetTrapBlock());
+    SealBlock(element_bb);
+    builder_.SetInsertPoint(element_bb);
   }
 
-  return_ =
-      builder_->CreateLoad(alloc->getAllocatedType(), alloc, name.c_str());
+  auto* const array = variables_[slot].array;
+  return builder_.CreateInBoundsGEP(array->getAllocatedType(), array,
+                                    {builder_.getInt64(0), index},
+                                    "elemptr");
 }
 
-void CodeGenerator::Impl::Visit([[maybe_unused]] CodeGenerator& visitor,
-                                NumberExpr& expr) {
-  return_ = llvm::ConstantInt::get(*context_,
-                                   llvm::APInt(64, expr.get_value(), true));
+llvm::Value* FunctionLowering::LowerDivision(const BinaryExpr& expr,
+                                             llvm::Value* const lhs,
+                                             llvm::Value* const rhs) {
+  const auto is_div = expr.get_op() == BinaryExpr::Op::kDiv;
+  if (!options_.check_division) {
+    return is_div ? builder_.CreateSDiv(lhs, rhs, "divtmp")
+                  : builder_.CreateSRem(lhs, rhs, "modtmp");
+  }
+  const auto* const constant = llvm::dyn_cast<llvm::ConstantInt>(rhs);
+  if (constant != nullptr && !constant->isZero()) {
+    if (constant->isMinusOne()) {
+      return is_div ? builder_.CreateNeg(lhs, "negtmp") : builder_.getInt64(0);
+    }
+    return is_div ? builder_.CreateSDiv(lhs, rhs, "divtmp")
+                  : builder_.CreateSRem(lhs, rhs, "modtmp");
+  }
+
+  auto* const nonzero =
+      builder_.CreateICmpNE(rhs, builder_.getInt64(0), "nonzero");
+  auto* const divide_bb = CreateBlock("divide");
+  builder_.CreateCondBr(nonzero, divide_bb, GetTrapBlock());
+  SealBlock(divide_bb);
+  builder_.SetInsertPoint(divide_bb);
+
+  // The range analysis folds the selects away for divisors that can't be
+  // -1.
+  auto* const is_minus_one =
+      builder_.CreateICmpEQ(rhs, builder_.getInt64(-1), "minusone");
+  auto* const divisor = builder_.CreateSelect(
+      is_minus_one, builder_.getInt64(1), rhs, "divisor");
+  if (is_div) {
+    return builder_.CreateSelect(is_minus_one,
+                                 builder_.CreateNeg(lhs, "negtmp"),
+                                 builder_.CreateSDiv(lhs, divisor, "divtmp"),
+                                 "quotient");
+  }
+  return builder_.CreateSelect(is_minus_one, builder_.getInt64(0),
+                               builder_.CreateSRem(lhs, divisor, "modtmp"),
+                               "remainder");
 }
 
-void CodeGenerator::Impl::Print() { module_->print(llvm::outs(), nullptr); }
+llvm::BasicBlock* FunctionLowering::GetTrapBlock() {
+  if (trap_block_ == nullptr) {
+    trap_block_ = CreateBlock("trap");
+    SealBlock(trap_block_);
+    auto builder = llvm::IRBuilder<>{trap_block_};
+    builder.CreateIntrinsic(llvm::Intrinsic::trap, {}, {});
+    builder.CreateUnreachable();
+  }
+  return trap_block_;
+}
 
-llvm::AllocaInst* CodeGenerator::Impl::CreateEntryBlockAlloca(
-    const std::string& name) {
-  auto& entry_block = main_->getEntryBlock();
-  auto builder = llvm::IRBuilder<>(&entry_block, entry_block.begin());
-  return builder.CreateAlloca(llvm::Type::getInt64Ty(*context_), nullptr, name);
+void FunctionLowering::SetLoopMetadata(llvm::Instruction& latch,
+                                       const LoopHints& hints) {
+  auto properties = llvm::SmallVector<llvm::Metadata*, 4>{nullptr};
+  const auto add = [&](const llvm::StringRef name, llvm::Metadata* value) {
+    auto operands = llvm::SmallVector<llvm::Metadata*, 2>{
+        llvm::MDString::get(context_, name)};
+    if (value != nullptr) {
+      operands.push_back(value);
+    }
+    properties.push_back(llvm::MDNode::get(context_, operands));
+  };
+  const auto i32 = [&](const std::int64_t value) {
+    return llvm::ConstantAsMetadata::get(builder_.getInt32(value));
+  };
+
+  if (hints.unroll == 1) {
+    add("llvm.loop.unroll.disable", nullptr);
+  } else if (hints.unroll != 0) {
+    add("llvm.loop.unroll.count", i32(hints.unroll));
+  }
+  if (hints.vectorize) {
+    add("llvm.loop.vectorize.enable",
+        llvm::ConstantAsMetadata::get(builder_.getTrue()));
+  }
+  if (hints.vectorize_width != 0) {
+    add("llvm.loop.vectorize.width", i32(hints.vectorize_width));
+  }
+
+  auto* const loop_id = llvm::MDNode::getDistinct(context_, properties);
+  loop_id->replaceOperandWith(0, loop_id);
+  latch.setMetadata(llvm::LLVMContext::MD_loop, loop_id);
 }
 
-llvm::Value* CodeGenerator::Impl::AcceptAndReturn(CodeGenerator& code_generator,
-                                                  INode& node) {
-  node.Accept(code_generator);
-  return return_;
+void FunctionLowering::AddArms(llvm::BasicBlock* const first,
+                               llvm::BasicBlock* const second,
+                               const bool is_loop) {
+  arms_.push_back({.first = first,
+                   .second = second,
+                   .counter = counter_count_,
+                   .is_loop = is_loop,
+                   .guards = {}});
+  counter_count_ += is_loop ? 4 : 2;
+  if (counters_ != nullptr) {
+    IncrementCounter(*first, arms_.back().counter);
+    IncrementCounter(*second, arms_.back().counter + 1);
+  }
 }
 
-llvm::Value* CodeGenerator::Impl::ToCondition(llvm::Value* const value) {
-  return builder_->CreateICmpNE(
-      value, llvm::ConstantInt::get(value->getType(), 0), "condition");
+void FunctionLowering::CountGuard() {
+  const auto& arms = arms_.back();
+  for (auto* const guard : arms.guards) {
+    // A guard branches to an arm as often as the condition of the branch
+    // takes that successor, which is counted without a block on the edge.
+    auto* const branch = llvm::cast<llvm::BranchInst>(guard->getTerminator());
+    auto builder = llvm::IRBuilder<>{branch};
+    for (auto i = 0U; i < branch->getNumSuccessors(); ++i) {
+      auto* const successor = branch->getSuccessor(i);
+      if (successor != arms.first && successor != arms.second) {
+        continue;
+      }
+
+      auto* taken = static_cast<llvm::Value*>(builder.getInt64(1));
+      if (branch->isConditional()) {
+        auto* const condition = branch->getCondition();
+        taken = builder.CreateZExt(
+            i == 0 ? condition : builder.CreateNot(condition),
+            builder.getInt64Ty());
+      }
+      AddToCounter(builder,
+                   arms.counter + (successor == arms.first ? 2 : 3), taken);
+    }
+  }
 }
 
-bool CodeGenerator::Impl::IsCurrentBlockTerminated() const {
-  const auto* const block = builder_->GetInsertBlock();
-  return block == nullptr || block->getTerminator() != nullptr;
+void FunctionLowering::IncrementCounter(llvm::BasicBlock& block,
+                                        const std::uint64_t index) {
+  auto builder = llvm::IRBuilder<>{&block};
+  AddToCounter(builder, index, builder.getInt64(1));
+}
+
+void FunctionLowering::AddToCounter(llvm::IRBuilder<>& builder,
+                                    const std::uint64_t index,
+                                    llvm::Value* const value) {
+  auto* const counter =
+      builder.CreateConstGEP1_64(builder.getInt64Ty(), counters_, index);
+  auto* const count = builder.CreateAlignedLoad(
+      builder.getInt64Ty(), counter, llvm::Align{8}, "count");
+  builder.CreateAlignedStore(builder.CreateAdd(count, value), counter,
+                             llvm::Align{8});
+}
+
+void FunctionLowering::SetProfileCounts(
+    const std::vector<std::uint64_t>& counts) {
+  if (counts.size() != counter_count_) {
+    return;
+  }
+
+  function_.setEntryCount(counts.front());
+  for (const auto& arms : arms_) {
+    const auto first = arms.first;
+    const auto second = arms.second;
+    // Only branches straight to both arms are weighted: with short-circuit
+    // evaluation, the branches on the operands of && and || aren't counted.
+    for (auto* const pred : llvm::predecessors(first)) {
+      auto* const branch =
+          llvm::dyn_cast<llvm::BranchInst>(pred->getTerminator());
+      if (branch == nullptr || !branch->isConditional()) {
+        continue;
+      }
+      auto first_count = counts[arms.counter];
+      auto second_count = counts[arms.counter + 1];
+      if (arms.is_loop) {
+        // The latch takes the branches to the arms that the guard doesn't.
+        const auto guard_first = counts[arms.counter + 2];
+        const auto guard_second = counts[arms.counter + 3];
+        if (llvm::is_contained(arms.guards, pred)) {
+          first_count = guard_first;
+          second_count = guard_second;
+        } else {
+          first_count -= std::min(first_count, guard_first);
+          second_count -= std::min(second_count, guard_second);
+        }
+      }
+      if (branch->getSuccessor(0) == first &&
+          branch->getSuccessor(1) == second) {
+        branch->setMetadata(
+            llvm::LLVMContext::MD_prof,
+            GetBranchWeights(context_, first_count, second_count));
+      } else if (branch->getSuccessor(0) == second &&
+                 branch->getSuccessor(1) == first) {
+        branch->setMetadata(
+            llvm::LLVMContext::MD_prof,
+            GetBranchWeights(context_, second_count, first_count));
+      }
+    }
+  }
 }
 
-void CodeGenerator::Impl::VisitStatements(
-    CodeGenerator& visitor, std::vector<std::unique_ptr<IStmt>>::iterator begin,
-    const std::vector<std::unique_ptr<IStmt>>::iterator end) {
-  for (auto it = begin; it != end && !IsCurrentBlockTerminated(); ++it) {
-    (*it)->Accept(visitor);
+void FunctionLowering::WriteVariable(const Slot slot,
+                                     llvm::BasicBlock* const block,
+                                     llvm::Value* const value) {
+  variables_[slot].definitions[block] = value;
+}
+
+llvm::Value* FunctionLowering::ReadVariable(const Slot slot,
+                                            llvm::BasicBlock* block) {
+  const auto& definitions = variables_[slot].definitions;
+  auto pending = std::vector<PendingPhi>{};
+  auto passed = llvm::SmallVector<llvm::BasicBlock*, 4>{};
+  while (true) {
+    llvm::Value* value = nullptr;
+    while (value == nullptr) {
+      if (const auto it = definitions.find(block); it != definitions.end()) {
+        value = it->second;
+      } else if (!sealed_blocks_.contains(block)) {
+        auto* const phi = CreatePhi(slot, block);
+        incomplete_phis_[block].emplace_back(slot, phi);
+        WriteVariable(slot, block, phi);
+        value = phi;
+      } else if (auto* const pred = block->getSinglePredecessor()) {
+        passed.push_back(block);
+        block = pred;
+      } else if (auto* const head = SkipJoin(slot, block)) {
+        passed.push_back(block);
+        block = head;
+      } else if (llvm::pred_empty(block)) {
+        // Scoping makes every read dominated by a write, so only reads in
+        // blocks without predecessors end up here.
+        value = llvm::PoisonValue::get(llvm::Type::getInt64Ty(context_));
+        WriteVariable(slot, block, value);
+      } else {
+        // Break cycles through loops by defining the variable before reading
+        // the predecessors.
+        auto* const phi = CreatePhi(slot, block);
+        WriteVariable(slot, block, phi);
+        pending.push_back({.block = block,
+                           .phi = phi,
+                           .preds = {llvm::pred_begin(block),
+                                     llvm::pred_end(block)},
+                           .passed = std::move(passed)});
+        passed.clear();
+        block = pending.back().preds.front();
+      }
+    }
+
+    for (auto* const passed_block : passed) {
+      WriteVariable(slot, passed_block, value);
+    }
+    passed.clear();
+
+    // Hands the value to the join that asked for it. A join whose operands
+    // are all known is finished, and its value goes to the join before it.
+    while (!pending.empty()) {
+      auto& join = pending.back();
+      join.phi->addIncoming(value, join.preds[join.next_pred++]);
+      if (join.next_pred < join.preds.size()) {
+        break;
+      }
+
+      value = TryRemoveTrivialPhi(join.phi);
+      WriteVariable(slot, join.block, value);
+      for (auto* const passed_block : join.passed) {
+        WriteVariable(slot, passed_block, value);
+      }
+      pending.pop_back();
+    }
+
+    if (pending.empty()) {
+      return value;
+    }
+    block = pending.back().preds[pending.back().next_pred];
+  }
+}
+
+llvm::BasicBlock* FunctionLowering::SkipJoin(
+    const Slot slot, llvm::BasicBlock* const block) const {
+  const auto it = joins_.find(block);
+  if (it == joins_.end()) {
+    return nullptr;
+  }
+
+  const auto& join = it->second;
+  const auto& writes = variables_[slot].writes;
+  const auto next = std::ranges::lower_bound(writes, join.first_write);
+  return next == writes.end() || *next >= join.end_write ? join.head
+                                                         : nullptr;
+}
+
+llvm::PHINode* FunctionLowering::CreatePhi(const Slot slot,
+                                           llvm::BasicBlock* const block) {
+  auto builder = llvm::IRBuilder<>(block, block->begin());
+  const auto name = symbols_.get_name(variables_[slot].symbol);
+  return builder.CreatePHI(llvm::Type::getInt64Ty(context_), 2,
+                           llvm::StringRef{name.data(), name.size()});
+}
+
+llvm::Value* FunctionLowering::AddPhiOperands(const Slot slot,
+                                              llvm::PHINode* const phi) {
+  for (llvm::BasicBlock* const pred : llvm::predecessors(phi->getParent())) {
+    phi->addIncoming(ReadVariable(slot, pred), pred);
+  }
+
+  return TryRemoveTrivialPhi(phi);
+}
+
+llvm::Value* FunctionLowering::TryRemoveTrivialPhi(
+    llvm::PHINode* const phi) {
+  auto phi_users = std::vector<llvm::WeakVH>{};
+  auto* const same = RemoveTrivialPhi(phi, phi_users);
+  if (same == nullptr) {
+    return phi;
+  }
+
+  // Removing this phi may have made the phis using it trivial as well, which
+  // can in turn replace the value it was replaced with. They're tried depth
+  // first, users of a removed phi before the next user of the one it used.
+  struct Users final {
+    std::vector<llvm::WeakVH> phis;
+    std::size_t next = 0;
+  };
+  auto result = llvm::WeakTrackingVH{same};
+  auto stack = std::vector<Users>{};
+  stack.push_back({std::move(phi_users)});
+  while (!stack.empty()) {
+    auto& users = stack.back();
+    if (users.next == users.phis.size()) {
+      stack.pop_back();
+      continue;
+    }
+
+    auto* const user_phi =
+        llvm::dyn_cast_or_null<llvm::PHINode>(users.phis[users.next++]);
+    auto user_users = std::vector<llvm::WeakVH>{};
+    if (user_phi != nullptr && RemoveTrivialPhi(user_phi, user_users)) {
+      stack.push_back({std::move(user_users)});
+    }
+  }
+
+  return result;
+}
+
+llvm::Value* FunctionLowering::RemoveTrivialPhi(
+    llvm::PHINode* const phi, std::vector<llvm::WeakVH>& phi_users) {
+  llvm::Value* same = nullptr;
+  for (llvm::Value* const op : phi->incoming_values()) {
+    if (op == same || op == phi) {
+      continue;
+    }
+    if (same != nullptr) {
+      return nullptr;
+    }
+    same = op;
+  }
+
+  if (same == nullptr) {
+    same = llvm::PoisonValue::get(phi->getType());
+  }
+
+  for (auto* const user : phi->users()) {
+    if (user != phi && llvm::isa<llvm::PHINode>(user)) {
+      phi_users.emplace_back(user);
+    }
   }
+
+  phi->replaceAllUsesWith(same);
+  phi->eraseFromParent();
+  return same;
+}
+
+void FunctionLowering::SealBlock(llvm::BasicBlock* const block) {
+  if (const auto it = incomplete_phis_.find(block);
+      it != incomplete_phis_.end()) {
+    const auto phis = std::move(it->second);
+    incomplete_phis_.erase(it);
+    for (const auto& [slot, phi] : phis) {
+      AddPhiOperands(slot, phi);
+    }
+  }
+
+  sealed_blocks_.insert(block);
 }
 
-CodeGenerator::CodeGenerator()
-    : impl_(std::make_unique<CodeGenerator::Impl>()) {}
+llvm::BasicBlock* FunctionLowering::CreateBlock(const std::string& name) {
+  return llvm::BasicBlock::Create(context_, name, &function_);
+}
+
+void FunctionLowering::PushTask(const Task& task) {
+  tasks_.push_back(task);
+}
+
+void FunctionLowering::PushValue(llvm::Value* const value) {
+  values_.push_back(value);
+}
+
+llvm::Value* FunctionLowering::PopValue() {
+  auto* const value = values_.back();
+  values_.pop_back();
+  return value;
+}
+
+llvm::Value* FunctionLowering::FinishCondition(
+    llvm::Value* const condition, const bool is_condition,
+    const std::string& name) {
+  if (is_condition) {
+    return condition;
+  }
+  return builder_.CreateZExt(condition, llvm::Type::getInt64Ty(context_),
+                              name);
+}
+
+llvm::Value* FunctionLowering::ToCondition(llvm::Value* const value) {
+  return builder_.CreateICmpNE(
+      value, llvm::ConstantInt::get(value->getType(), 0), "condition");
+}
+
+bool FunctionLowering::IsCurrentBlockTerminated() const {
+  const auto* const block = builder_.GetInsertBlock();
+  return block == nullptr || block->getTerminator() != nullptr;
+}
+
+CodeGenerator::CodeGenerator(const SymbolTable& symbols, Session& session,
+                             const CodeGenOptions& options)
+    : impl_(std::make_unique<CodeGenerator::Impl>(symbols, session, options)) {}
 
 CodeGenerator::~CodeGenerator() = default;
 
-void CodeGenerator::Visit(Program& program) { impl_->Visit(*this, program); }
-void CodeGenerator::Visit(AssignStmt& stmt) { impl_->Visit(*this, stmt); }
-void CodeGenerator::Visit(IfStmt& stmt) { impl_->Visit(*this, stmt); }
-void CodeGenerator::Visit(WhileStmt& stmt) { impl_->Visit(*this, stmt); }
-void CodeGenerator::Visit(ReturnStmt& stmt) { impl_->Visit(*this, stmt); }
-void CodeGenerator::Visit(BinaryExpr& expr) { impl_->Visit(*this, expr); }
-void CodeGenerator::Visit(UnaryExpr& expr) { impl_->Visit(*this, expr); }
-void CodeGenerator::Visit(VarExpr& expr) { impl_->Visit(*this, expr); }
-void CodeGenerator::Visit(NumberExpr& expr) { impl_->Visit(*this, expr); }
-
-void CodeGenerator::Print() { impl_->Print(); }
+void CodeGenerator::set_statistics(Statistics* const statistics) noexcept {
+  impl_->set_statistics(statistics);
+}
+
+void CodeGenerator::Visit(Program& program) { impl_->Generate(program); }
+
+void CodeGenerator::Visit(FunctionDef& def) { impl_->GenerateFunction(def); }
+
+void CodeGenerator::Visit(AssignStmt& stmt) { impl_->Lower(stmt); }
+void CodeGenerator::Visit(StoreStmt& stmt) { impl_->Lower(stmt); }
+void CodeGenerator::Visit(ArrayDeclStmt& stmt) { impl_->Lower(stmt); }
+void CodeGenerator::Visit(IfStmt& stmt) { impl_->Lower(stmt); }
+void CodeGenerator::Visit(WhileStmt& stmt) { impl_->Lower(stmt); }
+void CodeGenerator::Visit(ReturnStmt& stmt) { impl_->Lower(stmt); }
+void CodeGenerator::Visit(BinaryExpr& expr) { impl_->Lower(expr); }
+void CodeGenerator::Visit(UnaryExpr& expr) { impl_->Lower(expr); }
+void CodeGenerator::Visit(VarExpr& expr) { impl_->Lower(expr); }
+void CodeGenerator::Visit(NumberExpr& expr) { impl_->Lower(expr); }
+void CodeGenerator::Visit(CallExpr& expr) { impl_->Lower(expr); }
+void CodeGenerator::Visit(IndexExpr& expr) { impl_->Lower(expr); }
+void CodeGenerator::Visit(LengthExpr& expr) { impl_->Lower(expr); }
+
+void CodeGenerator::GenerateStmts(const StmtList stmts) {
+  impl_->GenerateStmts(stmts);
+}
+
+void CodeGenerator::FinishProgram() { impl_->FinishProgram(); }
+
+void CodeGenerator::Optimize(const std::string_view pipeline) {
+  impl_->Optimize(pipeline);
+}
+
+void CodeGenerator::Emit(const EmitKind kind, const std::string& filename) {
+  impl_->Emit(kind, filename);
+}
+
+void CodeGenerator::Emit(const EmitKind kind,
+                         llvm::raw_pwrite_stream& output) {
+  impl_->Emit(kind, output);
+}
+
+OwnedModule CodeGenerator::TakeModule() {
+  return impl_->TakeModule();
+}
+
+std::int64_t CodeGenerator::Run() { return impl_->Run(); }
 
 }  // namespace frontend
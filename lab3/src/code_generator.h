@@ -1,21 +1,88 @@
 #pragma once
 
+#include <cstdint>
 #include <experimental/propagate_const>
 #include <memory>
+#include <string>
+#include <string_view>
 
+#include "node.h"
+#include "session.h"
+#include "symbol_table.h"
 #include "visitor.h"
 
+// clang-format off
+#include "llvm/ADT/STLFunctionalExtras.h"
+// clang-format on
+
+namespace llvm {
+class Module;
+class raw_pwrite_stream;
+}  // namespace llvm
+
 namespace frontend {
 
-class INode;
+class Profile;
+class Statistics;
+
+enum class EmitKind {
+  kIr,
+  kBitcode,
+  kAssembly,
+  kObject,
+};
+
+struct CodeGenOptions final {
+  // Evaluates the right operand of && and || only if the left one doesn't
+  // decide the result, instead of evaluating both.
+  bool short_circuit = false;
+  // Lowers and optimizes the functions of a program on up to this many
+  // threads. The module is the same for any number.
+  unsigned jobs = 1;
+  // Lets the -O2 and -O3 pipelines run LLVM's loop and SLP vectorizers.
+  bool vectorize = true;
+  // Traps on a zero divisor and wraps the least value divided by -1, as the
+  // interpreter does, instead of leaving both undefined as sdiv and srem do.
+  bool check_division = false;
+  // Counts how often every function is entered and every arm of an if or
+  // while statement is taken, and writes the counts to this file whenever
+  // main returns.
+  std::string instrument;
+  // Counts of an instrumented run, which become the entry counts of the
+  // functions and the weights of their branches.
+  std::shared_ptr<const Profile> profile;
+};
+
+// Opens the file for output of the kind, or stdout if the filename is "-",
+// writes it with `write`, and closes it. Throws if the file can't be written,
+// or if binary output would go to a terminal.
+void WriteOutput(EmitKind kind, const std::string& filename,
+                 llvm::function_ref<void(llvm::raw_pwrite_stream&)> write);
 
+// Lowers main into a module and a context of the compilation's own, and every
+// function of the program into a module and a context of its own, so that
+// functions are lowered and optimized in parallel. The modules are linked
+// together before the program is emitted or run. With one of LLVM's default
+// pipelines, every module goes through the pre-link half of the pipeline on
+// its own and the linked module through the link-time half, which inlines
+// across functions; other pipelines run over the linked module.
 class CodeGenerator final : public IVisitor {
  public:
-  CodeGenerator();
+  // The module targets the session's CPU; the session must outlive the
+  // generator.
+  CodeGenerator(const SymbolTable& symbols, Session& session,
+                const CodeGenOptions& options = {});
   ~CodeGenerator();
 
+  // Times the phases and counts the module in the statistics, which must
+  // outlive the generator.
+  void set_statistics(Statistics* statistics) noexcept;
+
   void Visit(Program& program) override;
+  void Visit(FunctionDef& def) override;
   void Visit(AssignStmt& stmt) override;
+  void Visit(StoreStmt& stmt) override;
+  void Visit(ArrayDeclStmt& stmt) override;
   void Visit(IfStmt& stmt) override;
   void Visit(WhileStmt& stmt) override;
   void Visit(ReturnStmt& stmt) override;
@@ -23,8 +90,33 @@ class CodeGenerator final : public IVisitor {
   void Visit(UnaryExpr& expr) override;
   void Visit(VarExpr& expr) override;
   void Visit(NumberExpr& expr) override;
+  void Visit(CallExpr& expr) override;
+  void Visit(IndexExpr& expr) override;
+  void Visit(LengthExpr& expr) override;
+
+  // Generates a program one part at a time, as the parser streams its
+  // top-level statements and functions: GenerateStmts lowers resolved and
+  // folded statements at the end of main, visiting a FunctionDef lowers the
+  // function, and FinishProgram rejects a program that falls through and
+  // verifies the modules. Visiting a Program does all of it.
+  void GenerateStmts(StmtList stmts);
+  void FinishProgram();
+
+  // Runs a textual new-pass-manager pipeline such as "default<O2>" or
+  // "sroa,instcombine,gvn" over the module.
+  void Optimize(std::string_view pipeline);
+
+  // Writes the module to a file, or to stdout if the filename is "-".
+  void Emit(EmitKind kind, const std::string& filename);
+  void Emit(EmitKind kind, llvm::raw_pwrite_stream& output);
+
+  // Links the module and hands it over with its context. The generator can't
+  // be used afterwards.
+  OwnedModule TakeModule();
 
-  void Print();
+  // Compiles the module in-process and returns the result of main. The module
+  // is handed over to the JIT, so the generator can't be used afterwards.
+  std::int64_t Run();
 
  private:
   class Impl;
@@ -0,0 +1,74 @@
+#include "compiler.h"
+
+#include "constant_folder.h"
+#include "resolver.h"
+#include "statistics.h"
+
+namespace frontend {
+
+Slot Analyze(Driver& driver) {
+  const auto region = TimePhase(driver.get_statistics(), Phase::kAnalyze);
+  auto* const program = driver.get_program();
+  auto resolver = Resolver{driver.get_symbols()};
+  program->Accept(resolver);
+
+  auto folder = ConstantFolder{driver.get_arena()};
+  program->Accept(folder);
+
+  return resolver.get_slot_count();
+}
+
+void Compile(Driver& driver, CodeGenerator& code_generator,
+             const std::string_view pipeline) {
+  Analyze(driver);
+  driver.get_program()->Accept(code_generator);
+
+  if (!pipeline.empty()) {
+    code_generator.Optimize(pipeline);
+  }
+}
+
+void CompileStreaming(Driver& driver, const std::string& filename,
+                      CodeGenerator& code_generator,
+                      const std::string_view pipeline) {
+  auto* const statistics = driver.get_statistics();
+  auto resolver = Resolver{driver.get_symbols()};
+  auto folder = ConstantFolder{driver.get_arena()};
+  resolver.BeginProgram();
+  driver.set_top_level_handler([&](INode& node) {
+    if (auto* const def = llvm::dyn_cast<FunctionDef>(&node)) {
+      {
+        const auto region = TimePhase(statistics, Phase::kAnalyze);
+        def->Accept(resolver);
+        def->Accept(folder);
+      }
+      def->Accept(code_generator);
+      return;
+    }
+
+    auto& stmt = llvm::cast<IStmt>(node);
+    auto stmts = StmtList{};
+    {
+      const auto region = TimePhase(statistics, Phase::kAnalyze);
+      if (!resolver.ResolveStmt(stmt)) {
+        return;
+      }
+      stmts = folder.FoldStmt(stmt);
+    }
+    code_generator.GenerateStmts(stmts);
+  });
+  driver.Parse(filename);
+  driver.set_top_level_handler(nullptr);
+
+  {
+    const auto region = TimePhase(statistics, Phase::kAnalyze);
+    resolver.EndProgram();
+  }
+  code_generator.FinishProgram();
+
+  if (!pipeline.empty()) {
+    code_generator.Optimize(pipeline);
+  }
+}
+
+}  // namespace frontend
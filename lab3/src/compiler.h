@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "code_generator.h"
+#include "driver.h"
+#include "symbol_table.h"
+
+namespace frontend {
+
+// Resolves and folds the program parsed by the driver, which every backend
+// needs first. Returns the number of variable slots main uses.
+Slot Analyze(Driver& driver);
+
+// Analyzes the program parsed by the driver, generates its module, and runs
+// the optimization pipeline over it unless the pipeline is empty. The module
+// is then emitted or run through the code generator.
+void Compile(Driver& driver, CodeGenerator& code_generator,
+             std::string_view pipeline);
+
+// Like Parse followed by Compile, but every top-level statement and function
+// is analyzed and lowered as soon as the driver has parsed it, and its nodes
+// are released right afterwards.
+void CompileStreaming(Driver& driver, const std::string& filename,
+                      CodeGenerator& code_generator,
+                      std::string_view pipeline);
+
+}  // namespace frontend
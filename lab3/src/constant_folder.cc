@@ -0,0 +1,363 @@
+#include "constant_folder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+namespace frontend {
+
+namespace {
+
+// Wrapping arithmetic: the conversion back to a signed type is modular.
+std::int64_t WrapAdd(const std::int64_t lhs, const std::int64_t rhs) {
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) +
+                                   static_cast<std::uint64_t>(rhs));
+}
+
+std::int64_t WrapSub(const std::int64_t lhs, const std::int64_t rhs) {
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) -
+                                   static_cast<std::uint64_t>(rhs));
+}
+
+std::int64_t WrapMul(const std::int64_t lhs, const std::int64_t rhs) {
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) *
+                                   static_cast<std::uint64_t>(rhs));
+}
+
+// sdiv and srem are undefined for a zero divisor and for the one quotient
+// that overflows, so those are left to run time.
+bool IsDivisionDefined(const std::int64_t lhs, const std::int64_t rhs) {
+  return rhs != 0 &&
+         !(lhs == std::numeric_limits<std::int64_t>::min() && rhs == -1);
+}
+
+std::optional<std::int64_t> FoldOperator(const BinaryExpr::Op op,
+                                         const std::int64_t lhs,
+                                         const std::int64_t rhs) {
+  switch (op) {
+    using enum BinaryExpr::Op;
+    case kAdd:
+      return WrapAdd(lhs, rhs);
+    case kSub:
+      return WrapSub(lhs, rhs);
+    case kMul:
+      return WrapMul(lhs, rhs);
+    case kDiv:
+      return IsDivisionDefined(lhs, rhs) ? std::optional{lhs / rhs}
+                                         : std::nullopt;
+    case kMod:
+      return IsDivisionDefined(lhs, rhs) ? std::optional{lhs % rhs}
+                                         : std::nullopt;
+    case kEq:
+      return lhs == rhs;
+    case kNe:
+      return lhs != rhs;
+    case kLt:
+      return lhs < rhs;
+    case kGt:
+      return lhs > rhs;
+    case kLe:
+      return lhs <= rhs;
+    case kGe:
+      return lhs >= rhs;
+    case kAnd:
+      return lhs != 0 && rhs != 0;
+    case kOr:
+      return lhs != 0 || rhs != 0;
+  }
+  return std::nullopt;
+}
+
+}  // namespace
+
+void ConstantFolder::Visit(Program& program) {
+  program.set_stmts(FoldBlock(program.get_stmts()));
+  for (auto* const def : program.get_functions()) {
+    def->Accept(*this);
+  }
+}
+
+void ConstantFolder::Visit(FunctionDef& def) {
+  def.set_stmts(FoldBlock(def.get_stmts()));
+}
+
+void ConstantFolder::Visit(AssignStmt& stmt) {
+  stmt.set_expr(Fold(stmt.get_expr()));
+  pending_stmts_.push_back(&stmt);
+}
+
+void ConstantFolder::Visit(StoreStmt& stmt) {
+  stmt.set_index(Fold(stmt.get_index()));
+  stmt.set_expr(Fold(stmt.get_expr()));
+  pending_stmts_.push_back(&stmt);
+}
+
+void ConstantFolder::Visit(ArrayDeclStmt& stmt) {
+  pending_stmts_.push_back(&stmt);
+}
+
+void ConstantFolder::Visit(IfStmt& stmt) {
+  stmt.set_cond(Fold(stmt.get_cond()));
+  if (value_) {
+    const auto taken = *value_ != 0 ? stmt.get_then_stmts()
+                                    : stmt.get_else_stmts();
+    for (auto* const taken_stmt : taken) {
+      taken_stmt->Accept(*this);
+    }
+    return;
+  }
+
+  stmt.set_then_stmts(FoldBlock(stmt.get_then_stmts()));
+  stmt.set_else_stmts(FoldBlock(stmt.get_else_stmts()));
+  pending_stmts_.push_back(&stmt);
+}
+
+void ConstantFolder::Visit(WhileStmt& stmt) {
+  stmt.set_cond(Fold(stmt.get_cond()));
+  if (value_ && *value_ == 0) {
+    return;
+  }
+
+  stmt.set_stmts(FoldBlock(stmt.get_stmts()));
+  pending_stmts_.push_back(&stmt);
+}
+
+void ConstantFolder::Visit(ReturnStmt& stmt) {
+  stmt.set_expr(Fold(stmt.get_expr()));
+  pending_stmts_.push_back(&stmt);
+}
+
+void ConstantFolder::Visit(BinaryExpr& expr) { Fold(expr); }
+
+void ConstantFolder::Visit(UnaryExpr& expr) { Fold(expr); }
+
+void ConstantFolder::Visit(VarExpr& expr) { Fold(expr); }
+
+void ConstantFolder::Visit(NumberExpr& expr) { Fold(expr); }
+
+void ConstantFolder::Visit(CallExpr& expr) { Fold(expr); }
+
+void ConstantFolder::Visit(IndexExpr& expr) { Fold(expr); }
+
+void ConstantFolder::Visit(LengthExpr& expr) { Fold(expr); }
+
+IExpr* ConstantFolder::Fold(IExpr& expr) {
+  if (!FoldShallow(expr)) {
+    FoldDeep(expr);
+  }
+  return expr_;
+}
+
+bool ConstantFolder::FoldShallow(IExpr& expr) {
+  switch (expr.get_kind()) {
+    case NodeKind::kBinaryExpr: {
+      auto& binary = llvm::cast<BinaryExpr>(expr);
+      if (!IsLeaf(binary.get_lhs()) || !IsLeaf(binary.get_rhs())) {
+        return false;
+      }
+      FoldBinary(binary, GetLeafValue(binary.get_lhs()),
+                 GetLeafValue(binary.get_rhs()));
+      return true;
+    }
+    case NodeKind::kUnaryExpr: {
+      auto& unary = llvm::cast<UnaryExpr>(expr);
+      if (!IsLeaf(unary.get_expr())) {
+        return false;
+      }
+      FoldUnary(unary, GetLeafValue(unary.get_expr()));
+      return true;
+    }
+    case NodeKind::kCallExpr: {
+      auto& call = llvm::cast<CallExpr>(expr);
+      if (!std::ranges::all_of(call.get_args(), [](const IExpr* arg) {
+            return IsLeaf(*arg);
+          })) {
+        return false;
+      }
+      FoldCall(call);
+      return true;
+    }
+    case NodeKind::kIndexExpr: {
+      auto& index = llvm::cast<IndexExpr>(expr);
+      if (!IsLeaf(index.get_index())) {
+        return false;
+      }
+      FoldIndex(index);
+      return true;
+    }
+    case NodeKind::kLengthExpr: {
+      SetConstant(llvm::cast<LengthExpr>(expr).get_length());
+      return true;
+    }
+    default: {
+      expr_ = &expr;
+      value_ = GetLeafValue(expr);
+      return true;
+    }
+  }
+}
+
+void ConstantFolder::FoldDeep(IExpr& expr) {
+  // An operator is visited twice: first to schedule its operands, then, once
+  // they're on folded_, to fold it. The root is folded last, so expr_ and
+  // value_ end up describing it.
+  frames_.clear();
+  frames_.push_back({&expr, false});
+  folded_.clear();
+  while (!frames_.empty()) {
+    const auto frame = frames_.back();
+    frames_.pop_back();
+    if (!frame.is_expanded && FoldShallow(*frame.expr)) {
+      folded_.push_back({expr_, value_});
+      continue;
+    }
+
+    switch (frame.expr->get_kind()) {
+      case NodeKind::kBinaryExpr: {
+        auto* const binary = llvm::cast<BinaryExpr>(frame.expr);
+        if (!frame.is_expanded) {
+          frames_.push_back({binary, true});
+          frames_.push_back({&binary->get_rhs(), false});
+          frames_.push_back({&binary->get_lhs(), false});
+          break;
+        }
+        const auto rhs = folded_.back();
+        folded_.pop_back();
+        const auto lhs = folded_.back();
+        binary->set_lhs(lhs.expr);
+        binary->set_rhs(rhs.expr);
+        FoldBinary(*binary, lhs.value, rhs.value);
+        folded_.back() = {expr_, value_};
+        break;
+      }
+      case NodeKind::kUnaryExpr: {
+        auto* const unary = llvm::cast<UnaryExpr>(frame.expr);
+        if (!frame.is_expanded) {
+          frames_.push_back({unary, true});
+          frames_.push_back({&unary->get_expr(), false});
+          break;
+        }
+        unary->set_expr(folded_.back().expr);
+        FoldUnary(*unary, folded_.back().value);
+        folded_.back() = {expr_, value_};
+        break;
+      }
+      case NodeKind::kCallExpr: {
+        auto* const call = llvm::cast<CallExpr>(frame.expr);
+        const auto args = call->get_args();
+        if (!frame.is_expanded) {
+          frames_.push_back({call, true});
+          for (auto it = args.rbegin(); it != args.rend(); ++it) {
+            frames_.push_back({*it, false});
+          }
+          break;
+        }
+        const auto first = folded_.end() - static_cast<std::ptrdiff_t>(
+                                               args.size());
+        std::ranges::transform(first, folded_.end(), args.begin(),
+                               &Folded::expr);
+        folded_.erase(first, folded_.end());
+        FoldCall(*call);
+        folded_.push_back({expr_, value_});
+        break;
+      }
+      case NodeKind::kIndexExpr: {
+        auto* const index = llvm::cast<IndexExpr>(frame.expr);
+        if (!frame.is_expanded) {
+          frames_.push_back({index, true});
+          frames_.push_back({&index->get_index(), false});
+          break;
+        }
+        index->set_index(folded_.back().expr);
+        FoldIndex(*index);
+        folded_.back() = {expr_, value_};
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+}
+
+void ConstantFolder::FoldBinary(BinaryExpr& expr,
+                                const std::optional<std::int64_t> lhs,
+                                const std::optional<std::int64_t> rhs) {
+  expr_ = &expr;
+  value_.reset();
+  if (lhs && rhs) {
+    if (const auto value = FoldOperator(expr.get_op(), *lhs, *rhs)) {
+      SetConstant(*value);
+    }
+  }
+}
+
+void ConstantFolder::FoldUnary(UnaryExpr& expr,
+                               const std::optional<std::int64_t> operand) {
+  expr_ = &expr;
+  value_.reset();
+  if (operand) {
+    switch (expr.get_op()) {
+      using enum UnaryExpr::Op;
+      case kNeg: {
+        SetConstant(WrapSub(0, *operand));
+        break;
+      }
+      case kNot: {
+        SetConstant(*operand == 0);
+        break;
+      }
+    }
+  }
+}
+
+void ConstantFolder::FoldCall(CallExpr& expr) {
+  expr_ = &expr;
+  value_.reset();
+}
+
+void ConstantFolder::FoldIndex(IndexExpr& expr) {
+  expr_ = &expr;
+  value_.reset();
+}
+
+bool ConstantFolder::IsLeaf(const IExpr& expr) {
+  return llvm::isa<VarExpr, NumberExpr>(expr);
+}
+
+std::optional<std::int64_t> ConstantFolder::GetLeafValue(const IExpr& expr) {
+  if (const auto* const number = llvm::dyn_cast<NumberExpr>(&expr)) {
+    return number->get_value();
+  }
+  return std::nullopt;
+}
+
+StmtList ConstantFolder::FoldStmt(IStmt& stmt) {
+  pending_stmts_.clear();
+  stmt.Accept(*this);
+  return pending_stmts_;
+}
+
+StmtList ConstantFolder::FoldBlock(const StmtList stmts) {
+  const auto begin = pending_stmts_.size();
+  for (auto* const stmt : stmts) {
+    stmt->Accept(*this);
+  }
+
+  // Blocks that keep their statements keep their storage in the arena.
+  const auto folded = StmtList{pending_stmts_}.subspan(begin);
+  const auto result = std::ranges::equal(folded, stmts)
+                          ? stmts
+                          : StmtList{arena_.Copy(folded)};
+  pending_stmts_.resize(begin);
+  return result;
+}
+
+void ConstantFolder::SetConstant(const std::int64_t value) {
+  expr_ = arena_.Make<NumberExpr>(value);
+  value_ = value;
+}
+
+}  // namespace frontend
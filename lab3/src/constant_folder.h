@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "arena.h"
+#include "node.h"
+#include "visitor.h"
+
+namespace frontend {
+
+// Rewrites the resolved AST before code generation. Unary and binary
+// expressions over constants are replaced by their value with the i64
+// semantics of the generated code: arithmetic wraps, comparisons and logical
+// operators yield 0 or 1. Divisions that would be undefined at run time are
+// left alone. An `if` with a constant condition is replaced by the statements
+// of the arm that is taken, and `while` loops with a false condition are
+// dropped. Function bodies are folded like main, calls and array elements keep
+// their place with their operands folded, and the length of an array becomes
+// a number.
+//
+// Arms are spliced into the enclosing block, which is only correct because
+// every name has already been bound to its slot by the Resolver. Expressions
+// are folded bottom-up from an explicit stack, so operator chains of any
+// length fold in constant stack space.
+class ConstantFolder final : public IVisitor {
+ public:
+  explicit ConstantFolder(NodeArena& arena) noexcept : arena_(arena) {}
+
+  void Visit(Program& program) override;
+  void Visit(FunctionDef& def) override;
+  void Visit(AssignStmt& stmt) override;
+  void Visit(StoreStmt& stmt) override;
+  void Visit(ArrayDeclStmt& stmt) override;
+  void Visit(IfStmt& stmt) override;
+  void Visit(WhileStmt& stmt) override;
+  void Visit(ReturnStmt& stmt) override;
+  void Visit(BinaryExpr& expr) override;
+  void Visit(UnaryExpr& expr) override;
+  void Visit(VarExpr& expr) override;
+  void Visit(NumberExpr& expr) override;
+  void Visit(CallExpr& expr) override;
+  void Visit(IndexExpr& expr) override;
+  void Visit(LengthExpr& expr) override;
+
+  // Folds a top-level statement and returns the statements that replace it,
+  // which stay valid until the next call.
+  StmtList FoldStmt(IStmt& stmt);
+
+ private:
+  // An operator waiting for its operands to be folded, or to be folded
+  // itself once they are.
+  struct Frame final {
+    IExpr* expr;
+    bool is_expanded;
+  };
+  struct Folded final {
+    IExpr* expr;
+    std::optional<std::int64_t> value;
+  };
+
+  // Returns the expression that replaces the given one; value_ holds its
+  // value if it's constant.
+  IExpr* Fold(IExpr& expr);
+  // Folds a leaf, or an operator over leaves, without the stacks. Returns
+  // false for deeper expressions.
+  bool FoldShallow(IExpr& expr);
+  void FoldDeep(IExpr& expr);
+  void FoldBinary(BinaryExpr& expr, std::optional<std::int64_t> lhs,
+                  std::optional<std::int64_t> rhs);
+  void FoldUnary(UnaryExpr& expr, std::optional<std::int64_t> operand);
+  // Calls and array elements are never constant; only their operands are
+  // folded.
+  void FoldCall(CallExpr& expr);
+  void FoldIndex(IndexExpr& expr);
+  StmtList FoldBlock(StmtList stmts);
+  void SetConstant(std::int64_t value);
+
+  // Variables and numbers. Lengths aren't leaves, so that folding always
+  // reaches and replaces them.
+  static bool IsLeaf(const IExpr& expr);
+  static std::optional<std::int64_t> GetLeafValue(const IExpr& expr);
+
+ private:
+  NodeArena& arena_;
+  IExpr* expr_ = nullptr;
+  std::optional<std::int64_t> value_;
+  // Reused across expressions.
+  std::vector<Frame> frames_;
+  std::vector<Folded> folded_;
+  // Statements of the blocks being rebuilt, innermost last.
+  std::vector<IStmt*> pending_stmts_;
+};
+
+}  // namespace frontend
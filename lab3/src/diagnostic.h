@@ -0,0 +1,47 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace frontend {
+
+// Where in the source a diagnostic points. Lines and columns count from 1, and
+// the end column is that of the last character, so it's one less than the
+// begin column for an empty range such as the end of the input.
+struct SourceRange final {
+  int line = 1;
+  int column = 1;
+  int end_line = 1;
+  int end_column = 1;
+};
+
+// An error in a program. Syntax errors have a range; errors found later, such
+// as an unknown variable, have none.
+struct Diagnostic final {
+  std::string message;
+  std::optional<SourceRange> range;
+};
+
+// Formats the diagnostic as the command line reports it: prefixed with the
+// name of the source and the range as "line.column-end", with the end left
+// out where it adds nothing, if it has a range.
+inline std::string Format(const Diagnostic& diagnostic,
+                          const std::string_view source_name) {
+  if (!diagnostic.range) {
+    return diagnostic.message;
+  }
+
+  const auto& range = *diagnostic.range;
+  auto text = std::string{source_name} + ':' + std::to_string(range.line) +
+              '.' + std::to_string(range.column);
+  if (range.line < range.end_line) {
+    text += '-' + std::to_string(range.end_line) + '.' +
+            std::to_string(range.end_column);
+  } else if (range.column < range.end_column) {
+    text += '-' + std::to_string(range.end_column);
+  }
+  return text + ": " + diagnostic.message;
+}
+
+}  // namespace frontend
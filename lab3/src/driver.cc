@@ -1,9 +1,20 @@
 #include "driver.h"
 
-#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
 
 namespace frontend {
 
+SyntaxError::SyntaxError(Diagnostic diagnostic,
+                         const std::string_view source_name)
+    : std::runtime_error(Format(diagnostic, source_name)),
+      diagnostic_(std::move(diagnostic)) {}
+
+const Diagnostic& SyntaxError::get_diagnostic() const noexcept {
+  return diagnostic_;
+}
+
 void Driver::set_trace_scanning(const bool is_active) noexcept {
   trace_scanning_ = is_active;
 }
@@ -12,26 +23,176 @@ void Driver::set_trace_parsing(const bool is_active) noexcept {
   trace_parsing_ = is_active;
 }
 
-void Driver::set_program(std::unique_ptr<Program>&& program) noexcept {
-  program_ = std::move(program);
+void Driver::set_top_level_handler(
+    std::function<void(INode&)> handler) {
+  top_level_handler_ = std::move(handler);
+}
+
+void Driver::set_statistics(Statistics* const statistics) noexcept {
+  statistics_ = statistics;
+}
+
+Statistics* Driver::get_statistics() noexcept { return statistics_; }
+
+Parser::symbol_type Driver::NextToken(Scanner& scanner) {
+  auto token = [&] {
+    if (next_token_ < scanned_tokens_.size()) {
+      return std::move(scanned_tokens_[next_token_++]);
+    }
+    if (scan_error_) {
+      std::rethrow_exception(std::exchange(scan_error_, nullptr));
+    }
+    return scanner.Get();
+  }();
+
+  if (statistics_ != nullptr && token.kind() != Parser::symbol_kind::S_YYEOF) {
+    ++statistics_->get_counters().tokens;
+  }
+  return token;
+}
+
+std::size_t Driver::BeginStmts() const noexcept {
+  return pending_stmts_.size();
+}
+
+void Driver::AddStmt(IStmt* const stmt) { pending_stmts_.push_back(stmt); }
+
+void Driver::AddProgramStmt(IStmt* const stmt) {
+  if (!top_level_handler_) {
+    AddStmt(stmt);
+    return;
+  }
+
+  // Tokens carry symbols and values but no nodes, so nothing the parser
+  // holds refers into the arena between top-level statements.
+  top_level_handler_(*stmt);
+  arena_.Reset();
+}
+
+StmtList Driver::EndStmts(const std::size_t begin) {
+  const auto stmts = arena_.Copy(StmtList{pending_stmts_}.subspan(begin));
+  pending_stmts_.resize(begin);
+  return stmts;
+}
+
+std::size_t Driver::BeginExprs() const noexcept {
+  return pending_exprs_.size();
+}
+
+void Driver::AddExpr(IExpr* const expr) { pending_exprs_.push_back(expr); }
+
+ExprList Driver::EndExprs(const std::size_t begin) {
+  const auto exprs = arena_.Copy(
+      std::span<IExpr* const>{pending_exprs_}.subspan(begin));
+  pending_exprs_.resize(begin);
+  return exprs;
+}
+
+std::size_t Driver::BeginParams() const noexcept {
+  return pending_params_.size();
+}
+
+void Driver::AddParam(const Symbol symbol) {
+  pending_params_.push_back(symbol);
 }
 
-Program* Driver::get_program() noexcept { return program_.get(); }
-const Program* Driver::get_program() const noexcept { return program_.get(); }
+ParamList Driver::EndParams(const std::size_t begin) {
+  const auto params = arena_.Copy(ParamList{pending_params_}.subspan(begin));
+  pending_params_.resize(begin);
+  return params;
+}
+
+void Driver::AddFunction(FunctionDef* const def) {
+  if (!top_level_handler_) {
+    functions_.push_back(def);
+    return;
+  }
+
+  top_level_handler_(*def);
+  arena_.Reset();
+}
+
+FunctionList Driver::EndFunctions() {
+  const auto functions = arena_.Copy(FunctionList{functions_});
+  functions_.clear();
+  return functions;
+}
+
+NodeArena& Driver::get_arena() noexcept { return arena_; }
+const NodeArena& Driver::get_arena() const noexcept { return arena_; }
+const SymbolTable& Driver::get_symbols() const noexcept { return symbols_; }
+
+void Driver::set_program(Program* const program) noexcept {
+  program_ = program;
+}
+
+Program* Driver::get_program() noexcept { return program_; }
+const Program* Driver::get_program() const noexcept { return program_; }
 
 void Driver::Parse(const std::string& filename) {
-  auto file = std::ifstream{filename};
-  if (!file.is_open()) {
-    throw std::runtime_error("Failed to open file " + filename);
+  ParseBuffer(Load(filename), filename);
+}
+
+std::string_view Driver::Load(const std::string& filename) {
+  // Without a null terminator requirement, large files are mapped instead of
+  // read into a heap buffer.
+  auto file = llvm::MemoryBuffer::getFile(filename, /*IsText=*/false,
+                                          /*RequiresNullTerminator=*/false);
+  if (!file) {
+    throw std::runtime_error("Failed to open file " + filename + ": " +
+                             file.getError().message());
   }
 
-  auto scanner = Scanner{file, std::cout, &filename};
+  source_file_ = std::move(*file);
+  return {source_file_->getBufferStart(), source_file_->getBufferSize()};
+}
+
+void Driver::ParseBuffer(const std::string_view source,
+                         const std::string& name) {
+  source_name_ = name;
+
+  auto scanner = Scanner{symbols_, source, &source_name_};
   scanner.set_debug(trace_scanning_);
 
   auto parser = Parser{scanner, *this};
   parser.set_debug_level(trace_parsing_);
 
-  parser.parse();
+  try {
+    // Scanning ahead would keep every token of the file at once, so a
+    // streamed parse scans as it goes.
+    if (statistics_ != nullptr && statistics_->is_timing() &&
+        !top_level_handler_) {
+      const auto region = statistics_->Time(Phase::kScan);
+      ScanTokens(scanner);
+    }
+
+    const auto region = TimePhase(statistics_, Phase::kParse);
+    parser.parse();
+  } catch (const Parser::syntax_error& e) {
+    const auto& begin = e.location.begin;
+    const auto& end = e.location.end;
+    throw SyntaxError{
+        Diagnostic{.message = e.what(),
+                   .range = SourceRange{.line = begin.line,
+                                        .column = begin.column,
+                                        .end_line = end.line,
+                                        .end_column = end.column - 1}},
+        source_name_};
+  }
+
+  scanned_tokens_.clear();
+  scanned_tokens_.shrink_to_fit();
+  next_token_ = 0;
+}
+
+void Driver::ScanTokens(Scanner& scanner) {
+  try {
+    do {
+      scanned_tokens_.push_back(scanner.Get());
+    } while (scanned_tokens_.back().kind() != Parser::symbol_kind::S_YYEOF);
+  } catch (const Parser::syntax_error&) {
+    scan_error_ = std::current_exception();
+  }
 }
 
 }  // namespace frontend
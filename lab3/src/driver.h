@@ -1,24 +1,129 @@
 #pragma once
 
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// clang-format off
+#include "llvm/Support/MemoryBuffer.h"
+// clang-format on
+
+#include "arena.h"
+#include "diagnostic.h"
 #include "node.h"
 #include "scanner.h"
+#include "statistics.h"
 
 namespace frontend {
 
+// A syntax error whose message starts with its location. Unlike the parser's
+// syntax_error, it doesn't refer to the file name owned by the driver, so it
+// can outlive the driver.
+class SyntaxError final : public std::runtime_error {
+ public:
+  SyntaxError(Diagnostic diagnostic, std::string_view source_name);
+
+  const Diagnostic& get_diagnostic() const noexcept;
+
+ private:
+  Diagnostic diagnostic_;
+};
+
 class Driver final {
   bool trace_scanning_ = false;
   bool trace_parsing_ = false;
-  std::unique_ptr<Program> program_;
+  std::string source_name_;
+  std::unique_ptr<llvm::MemoryBuffer> source_file_;
+  NodeArena arena_;
+  SymbolTable symbols_;
+  // Statements of the blocks being parsed; each block is copied into the
+  // arena as one contiguous list once its closing brace is reduced. Call
+  // arguments and parameters are collected the same way.
+  std::vector<IStmt*> pending_stmts_;
+  std::vector<IExpr*> pending_exprs_;
+  std::vector<Symbol> pending_params_;
+  std::vector<FunctionDef*> functions_;
+  Program* program_ = nullptr;
+  std::function<void(INode&)> top_level_handler_;
+  Statistics* statistics_ = nullptr;
+  // While timing, every token is scanned before parsing starts, so that the
+  // phases are timed apart. A scanning error is raised when the parser
+  // reaches it, so that an earlier syntax error is still reported first.
+  std::vector<Parser::symbol_type> scanned_tokens_;
+  std::size_t next_token_ = 0;
+  std::exception_ptr scan_error_;
 
  public:
+  // Memory-maps the file and parses it in place. Throws SyntaxError for
+  // malformed input.
   void Parse(const std::string& filename);
+  // Memory-maps the file without parsing it and returns its contents, which
+  // live as long as the driver.
+  std::string_view Load(const std::string& filename);
+  // Parses an in-memory buffer in place. Symbol names refer into the buffer,
+  // so it must outlive the driver.
+  void ParseBuffer(std::string_view source, const std::string& name);
 
   void set_trace_scanning(const bool is_active) noexcept;
   void set_trace_parsing(const bool is_active) noexcept;
 
-  void set_program(std::unique_ptr<Program>&& program) noexcept;
+  // Hands every top-level statement and function definition to the handler
+  // as soon as it's parsed, instead of adding it to the program, and
+  // releases the arena once the handler returns. The program is then left
+  // empty, and the memory of the AST is bounded by its largest statement or
+  // function rather than by the file. Nothing after a syntax error is handed
+  // over.
+  void set_top_level_handler(std::function<void(INode&)> handler);
+
+  // Times the scanner and the parser and counts tokens and nodes in the
+  // statistics, which must outlive the parse.
+  void set_statistics(Statistics* statistics) noexcept;
+  Statistics* get_statistics() noexcept;
+
+  // Returns the next token for the parser.
+  Parser::symbol_type NextToken(Scanner& scanner);
+
+  template <typename T, typename... Args>
+  T* Make(Args&&... args) {
+    if (statistics_ != nullptr) {
+      ++statistics_->get_counters().ast_nodes;
+    }
+    return arena_.Make<T>(std::forward<Args>(args)...);
+  }
+
+  std::size_t BeginStmts() const noexcept;
+  void AddStmt(IStmt* stmt);
+  // Adds a top-level statement, or hands it to the top-level handler.
+  void AddProgramStmt(IStmt* stmt);
+  StmtList EndStmts(std::size_t begin);
+
+  std::size_t BeginExprs() const noexcept;
+  void AddExpr(IExpr* expr);
+  ExprList EndExprs(std::size_t begin);
+
+  std::size_t BeginParams() const noexcept;
+  void AddParam(Symbol symbol);
+  ParamList EndParams(std::size_t begin);
+
+  // Adds a function definition, or hands it to the top-level handler.
+  void AddFunction(FunctionDef* def);
+  FunctionList EndFunctions();
+
+  NodeArena& get_arena() noexcept;
+  const NodeArena& get_arena() const noexcept;
+  const SymbolTable& get_symbols() const noexcept;
+
+  void set_program(Program* program) noexcept;
   Program* get_program() noexcept;
   const Program* get_program() const noexcept;
+
+ private:
+  void ScanTokens(Scanner& scanner);
 };
 
 }  // namespace frontend
@@ -0,0 +1,294 @@
+#include "interpreter.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace frontend {
+
+namespace {
+
+std::int64_t WrapAdd(const std::int64_t lhs, const std::int64_t rhs) {
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) +
+                                   static_cast<std::uint64_t>(rhs));
+}
+
+std::int64_t WrapSub(const std::int64_t lhs, const std::int64_t rhs) {
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) -
+                                   static_cast<std::uint64_t>(rhs));
+}
+
+std::int64_t WrapMul(const std::int64_t lhs, const std::int64_t rhs) {
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) *
+                                   static_cast<std::uint64_t>(rhs));
+}
+
+// The quotient that overflows wraps around to the dividend.
+std::int64_t Divide(const std::int64_t lhs, const std::int64_t rhs) {
+  if (rhs == 0) {
+    throw std::runtime_error("Division by zero");
+  }
+  if (rhs == -1) {
+    return WrapSub(0, lhs);
+  }
+  return lhs / rhs;
+}
+
+std::int64_t Remainder(const std::int64_t lhs, const std::int64_t rhs) {
+  if (rhs == 0) {
+    throw std::runtime_error("Division by zero");
+  }
+  if (rhs == -1) {
+    return 0;
+  }
+  return lhs % rhs;
+}
+
+// Returns the element of the array whose length register is at `array`.
+std::int64_t& GetElement(std::int64_t* const array, const std::int64_t index) {
+  if (static_cast<std::uint64_t>(index) >=
+      static_cast<std::uint64_t>(array[0])) {
+    throw std::runtime_error("Array index " + std::to_string(index) +
+                             " is out of bounds");
+  }
+  return array[index + 1];
+}
+
+// Out of line, so that every jump only adds a compare and a branch.
+[[noreturn]] void ThrowJumpLimit() {
+  throw std::runtime_error("Program ran too long");
+}
+
+// Deeper recursion is reported as an error, as it would overflow the stack
+// of the generated code.
+constexpr std::size_t kMaxCallDepth = std::size_t{1} << 20;
+
+// The caller of a frame: where its registers start, and the call to
+// return to.
+struct Frame final {
+  std::size_t base;
+  const BytecodeFunction* function;
+  const Instruction* call;
+};
+
+// Loads the constants of the function into its frame.
+void EnterFrame(const BytecodeFunction& function,
+                std::int64_t* const registers) {
+  std::copy(function.constants.begin(), function.constants.end(),
+            registers + function.constant_base);
+}
+
+}  // namespace
+
+std::int64_t Interpret(const Bytecode& bytecode, std::uint64_t max_jumps) {
+  // The frames of all active calls, one after another. Registers are
+  // written before they're read, so frames aren't cleared when reused.
+  const auto* function = &bytecode.functions.front();
+  auto stack = std::vector<std::int64_t>(function->register_count);
+  auto frames = std::vector<Frame>{};
+  auto base = std::size_t{0};
+  auto* registers = stack.data();
+  EnterFrame(*function, registers);
+
+  const auto* const code = bytecode.code.data();
+  const auto* instruction = code + function->entry;
+
+// With GNU C labels as values, every handler jumps straight to the next one,
+// which gives the indirect branches a history of their own to predict from.
+// Elsewhere a loop around a switch dispatches instead.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+  static void* const kHandlers[] = {
+      &&kMove, &&kAdd, &&kSub, &&kMul, &&kDiv, &&kMod,
+      &&kEq, &&kNe, &&kLt, &&kGt, &&kLe, &&kGe,
+      &&kAnd, &&kOr, &&kNeg, &&kNot, &&kReturn, &&kCall,
+      &&kZeroArray, &&kLoadElement, &&kStoreElement,
+      &&kJump, &&kJumpIfZero, &&kJumpIfNonZero,
+      &&kAddImmediate, &&kJumpIfEq, &&kJumpIfNe, &&kJumpIfLt, &&kJumpIfGt,
+      &&kJumpIfLe, &&kJumpIfGe,
+  };
+  static_assert(std::size(kHandlers) ==
+                static_cast<std::size_t>(Opcode::kJumpIfGe) + 1);
+#define DISPATCH() goto* kHandlers[static_cast<int>(instruction->op)]
+#define HANDLER(op) op:
+#define NEXT()     \
+  ++instruction;   \
+  DISPATCH()
+#define JUMP(target)                 \
+  if (max_jumps-- == 0) {            \
+    ThrowJumpLimit();                \
+  }                                  \
+  instruction = code + (target);     \
+  DISPATCH()
+  DISPATCH();
+#else
+#define HANDLER(op) case Opcode::op:
+#define NEXT()   \
+  ++instruction; \
+  continue
+#define JUMP(target)             \
+  if (max_jumps-- == 0) {        \
+    ThrowJumpLimit();            \
+  }                              \
+  instruction = code + (target); \
+  continue
+  for (;;) {
+    switch (instruction->op) {
+#endif
+
+#define A registers[instruction->a]
+#define B registers[instruction->b]
+#define C registers[instruction->c]
+#define BRANCH_IF(condition) \
+  if (condition) {           \
+    JUMP(instruction->a);    \
+  }                          \
+  NEXT()
+
+  HANDLER(kMove) {
+    A = B;
+    NEXT();
+  }
+  HANDLER(kAdd) {
+    A = WrapAdd(B, C);
+    NEXT();
+  }
+  HANDLER(kSub) {
+    A = WrapSub(B, C);
+    NEXT();
+  }
+  HANDLER(kMul) {
+    A = WrapMul(B, C);
+    NEXT();
+  }
+  HANDLER(kDiv) {
+    A = Divide(B, C);
+    NEXT();
+  }
+  HANDLER(kMod) {
+    A = Remainder(B, C);
+    NEXT();
+  }
+  HANDLER(kEq) {
+    A = B == C;
+    NEXT();
+  }
+  HANDLER(kNe) {
+    A = B != C;
+    NEXT();
+  }
+  HANDLER(kLt) {
+    A = B < C;
+    NEXT();
+  }
+  HANDLER(kGt) {
+    A = B > C;
+    NEXT();
+  }
+  HANDLER(kLe) {
+    A = B <= C;
+    NEXT();
+  }
+  HANDLER(kGe) {
+    A = B >= C;
+    NEXT();
+  }
+  HANDLER(kAnd) {
+    A = B != 0 && C != 0;
+    NEXT();
+  }
+  HANDLER(kOr) {
+    A = B != 0 || C != 0;
+    NEXT();
+  }
+  HANDLER(kNeg) {
+    A = WrapSub(0, B);
+    NEXT();
+  }
+  HANDLER(kNot) {
+    A = B == 0;
+    NEXT();
+  }
+  HANDLER(kReturn) {
+    const auto value = A;
+    if (frames.empty()) {
+      return value;
+    }
+
+    const auto frame = frames.back();
+    frames.pop_back();
+    base = frame.base;
+    function = frame.function;
+    registers = stack.data() + base;
+    instruction = frame.call;
+    A = value;
+    NEXT();
+  }
+  HANDLER(kCall) {
+    if (frames.size() == kMaxCallDepth) {
+      throw std::runtime_error("Call stack overflow");
+    }
+
+    const auto& callee = bytecode.functions[instruction->b];
+    const auto callee_base = base + function->register_count;
+    if (stack.size() < callee_base + callee.register_count) {
+      stack.resize(callee_base + callee.register_count);
+    }
+    frames.push_back({base, function, instruction});
+    std::copy_n(stack.data() + base + instruction->c, callee.param_count,
+                stack.data() + callee_base);
+    base = callee_base;
+    function = &callee;
+    registers = stack.data() + base;
+    EnterFrame(callee, registers);
+    JUMP(callee.entry);
+  }
+  HANDLER(kZeroArray) {
+    A = instruction->b;
+    std::fill_n(&A + 1, instruction->b, 0);
+    NEXT();
+  }
+  HANDLER(kLoadElement) {
+    A = GetElement(&B, C);
+    NEXT();
+  }
+  HANDLER(kStoreElement) {
+    GetElement(&A, B) = C;
+    NEXT();
+  }
+  HANDLER(kJump) { JUMP(instruction->a); }
+  HANDLER(kJumpIfZero) { BRANCH_IF(B == 0); }
+  HANDLER(kJumpIfNonZero) { BRANCH_IF(B != 0); }
+  HANDLER(kAddImmediate) {
+    A = WrapAdd(B, static_cast<std::int32_t>(instruction->c));
+    NEXT();
+  }
+  HANDLER(kJumpIfEq) { BRANCH_IF(B == C); }
+  HANDLER(kJumpIfNe) { BRANCH_IF(B != C); }
+  HANDLER(kJumpIfLt) { BRANCH_IF(B < C); }
+  HANDLER(kJumpIfGt) { BRANCH_IF(B > C); }
+  HANDLER(kJumpIfLe) { BRANCH_IF(B <= C); }
+  HANDLER(kJumpIfGe) { BRANCH_IF(B >= C); }
+
+#undef BRANCH_IF
+#undef C
+#undef B
+#undef A
+#undef JUMP
+#undef NEXT
+#undef HANDLER
+#if defined(__GNUC__)
+#undef DISPATCH
+#pragma GCC diagnostic pop
+#else
+    }
+  }
+#endif
+}
+
+}  // namespace frontend
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#include "bytecode.h"
+
+namespace frontend {
+
+// Runs main and returns the value of the return statement reached.
+// Arithmetic wraps around like the generated code, and a division by zero, an
+// array index out of bounds, or a recursion deeper than the interpreter's
+// call stack throws instead of trapping. Calls push frames on a stack of
+// their own, so the depth of the native stack doesn't depend on the program.
+// Every loop iteration and call takes a jump, so a program that would take
+// more than `max_jumps` throws instead of running on.
+std::int64_t Interpret(
+    const Bytecode& bytecode,
+    std::uint64_t max_jumps = std::numeric_limits<std::uint64_t>::max());
+
+}  // namespace frontend
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdexcept>
+#include <utility>
+
+// clang-format off
+#include "llvm/Support/Error.h"
+// clang-format on
+
+namespace frontend {
+
+// LLVM reports recoverable failures through llvm::Expected and llvm::Error,
+// which must be consumed; these turn them into exceptions.
+template <typename T>
+T Unwrap(llvm::Expected<T>&& expected) {
+  if (!expected) {
+    throw std::runtime_error(llvm::toString(expected.takeError()));
+  }
+  return std::move(*expected);
+}
+
+inline void Check(llvm::Error&& error) {
+  if (error) {
+    throw std::runtime_error(llvm::toString(std::move(error)));
+  }
+}
+
+}  // namespace frontend
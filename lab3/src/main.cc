@@ -1,21 +1,305 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// clang-format off
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+// clang-format on
+
+#include "bytecode_compiler.h"
+#include "cache.h"
 #include "code_generator.h"
+#include "compiler.h"
 #include "driver.h"
+#include "interpreter.h"
+#include "options.h"
+#include "server.h"
+#include "session.h"
+#include "statistics.h"
+
+namespace {
+
+struct MemoryUsage final {
+  std::size_t bytes_used = 0;
+  std::size_t bytes_reserved = 0;
+};
+
+std::string_view GetExtension(const frontend::EmitKind kind) {
+  switch (kind) {
+    case frontend::EmitKind::kIr:
+      return ".ll";
+    case frontend::EmitKind::kBitcode:
+      return ".bc";
+    case frontend::EmitKind::kAssembly:
+      return ".s";
+    case frontend::EmitKind::kObject:
+      return ".o";
+  }
+  return {};
+}
+
+// Compiles one file in the session and returns its exit status. Everything
+// else the compilation touches is owned by this call, so files can be
+// compiled concurrently in sessions of their own. With a cache, an output
+// found there is written without compiling anything.
+int CompileFile(const frontend::Options& options, frontend::Session& session,
+                frontend::Cache* const cache, const std::string& filename,
+                const std::string& output, MemoryUsage& usage) {
+  auto report = std::optional<frontend::Statistics>{};
+  if (options.time_phases || options.stats) {
+    report.emplace(options.time_phases);
+  }
+  auto* const statistics = report ? &*report : nullptr;
+
+  auto driver = frontend::Driver{};
+  driver.set_statistics(statistics);
+  const auto emit_kind = options.emit_kind.value_or(frontend::EmitKind::kIr);
+  auto source = std::string_view{};
+  auto cache_key = std::string{};
+  auto cached = std::unique_ptr<llvm::MemoryBuffer>{};
+  if (cache != nullptr) {
+    source = driver.Load(filename);
+    cache_key = frontend::Cache::GetKey(source, options);
+    cached = cache->Find(cache_key);
+    if (statistics != nullptr) {
+      ++(cached ? statistics->get_counters().cache_hits
+                : statistics->get_counters().cache_misses);
+    }
+  }
+  if (cached == nullptr && !options.stream) {
+    if (cache != nullptr) {
+      driver.ParseBuffer(source, filename);
+    } else {
+      driver.Parse(filename);
+    }
+  }
+
+  auto status = 0;
+  if (cached != nullptr) {
+    const auto region = TimePhase(statistics, frontend::Phase::kEmit);
+    frontend::WriteOutput(emit_kind, output,
+                          [&](llvm::raw_pwrite_stream& file) {
+                            file << cached->getBuffer();
+                          });
+    if (statistics != nullptr) {
+      statistics->get_counters().bytes_emitted = cached->getBufferSize();
+    }
+  } else if (options.interpret) {
+    auto compiler = frontend::BytecodeCompiler{frontend::Analyze(driver),
+                                               options.codegen};
+    auto bytecode = [&] {
+      const auto region = TimePhase(statistics, frontend::Phase::kCodegen);
+      driver.get_program()->Accept(compiler);
+      return compiler.TakeBytecode();
+    }();
+    const auto region = TimePhase(statistics, frontend::Phase::kRun);
+    status = static_cast<int>(frontend::Interpret(bytecode));
+  } else {
+    auto code_generator = frontend::CodeGenerator{driver.get_symbols(),
+                                                  session, options.codegen};
+    code_generator.set_statistics(statistics);
+    if (options.stream) {
+      frontend::CompileStreaming(driver, filename, code_generator,
+                                 options.pipeline);
+    } else {
+      frontend::Compile(driver, code_generator, options.pipeline);
+    }
+
+    if (options.run) {
+      status = static_cast<int>(code_generator.Run());
+    } else if (cache != nullptr) {
+      auto contents = llvm::SmallString<0>{};
+      auto stream = llvm::raw_svector_ostream{contents};
+      code_generator.Emit(emit_kind, stream);
+      cache->Store(cache_key, contents.str());
+      frontend::WriteOutput(
+          emit_kind, output,
+          [&](llvm::raw_pwrite_stream& file) { file << contents; });
+    } else {
+      code_generator.Emit(emit_kind, output);
+    }
+  }
+
+  if (report) {
+    report->Print(llvm::errs(), options.report_format, options.stats);
+  }
+
+  usage.bytes_used = driver.get_arena().get_peak_bytes_allocated();
+  usage.bytes_reserved = driver.get_arena().get_peak_total_memory();
+  return status;
+}
+
+// Describes the exception being handled, prefixed with the file name unless
+// the message already starts with a location.
+std::string DescribeError(const std::string& filename) {
+  try {
+    throw;
+  } catch (const frontend::SyntaxError& e) {
+    return e.what();
+  } catch (const std::exception& e) {
+    return filename + ": " + e.what();
+  }
+}
+
+// Returns the output of every file of a batch: the file with the extension of
+// the kind. Throws if two files would be written to the same output, such as a
+// file listed twice or files differing only in their extension, since their
+// jobs would write it concurrently.
+std::vector<std::string> GetBatchOutputs(
+    const std::vector<std::string>& filenames, const frontend::EmitKind kind) {
+  auto outputs = std::vector<std::string>{};
+  auto inputs = llvm::StringMap<std::size_t>{};
+  for (auto i = std::size_t{0}; i < filenames.size(); ++i) {
+    auto output = llvm::SmallString<128>{filenames[i]};
+    llvm::sys::path::replace_extension(output, GetExtension(kind));
+    outputs.push_back(output.str().str());
+
+    llvm::sys::fs::make_absolute(output);
+    llvm::sys::path::remove_dots(output, /*remove_dot_dot=*/true);
+    const auto [it, is_new] = inputs.try_emplace(output, i);
+    if (!is_new) {
+      throw std::runtime_error(filenames[it->second] + " and " + filenames[i] +
+                               " would both be compiled to " + outputs[i]);
+    }
+  }
+  return outputs;
+}
+
+// Compiles every file on a pool of worker threads with a session each. A
+// failing file is reported and doesn't stop the others.
+bool CompileBatch(const frontend::Options& options, frontend::Session& session,
+                  frontend::Cache* const cache, MemoryUsage& total_usage) {
+  const auto& filenames = options.filenames;
+  const auto jobs = static_cast<unsigned>(std::min<std::size_t>(
+      frontend::GetJobCount(options), filenames.size()));
+
+  const auto emit_kind = options.emit_kind.value_or(frontend::EmitKind::kIr);
+  const auto outputs = GetBatchOutputs(filenames, emit_kind);
+  auto usages = std::vector<MemoryUsage>(filenames.size());
+  auto next = std::atomic<std::size_t>{0};
+  auto has_failed = std::atomic<bool>{false};
+  auto error_mutex = std::mutex{};
+
+  const auto work = [&](frontend::Session& worker_session) {
+    for (auto i = next++; i < filenames.size(); i = next++) {
+      try {
+        CompileFile(options, worker_session, cache, filenames[i], outputs[i],
+                    usages[i]);
+      } catch (...) {
+        const auto message = DescribeError(filenames[i]);
+        has_failed = true;
+        const auto lock = std::scoped_lock{error_mutex};
+        std::cerr << message << std::endl;
+      }
+    }
+  };
+
+  {
+    auto workers = std::vector<std::jthread>{};
+    workers.reserve(jobs - 1);
+    for (auto i = 1U; i < jobs; ++i) {
+      // The target CPU was validated by the main session, so creating
+      // another one doesn't throw.
+      workers.emplace_back([&] {
+        auto worker_session = frontend::Session{options.target_cpu};
+        work(worker_session);
+      });
+    }
+    work(session);
+  }
+
+  for (const auto& usage : usages) {
+    total_usage.bytes_used += usage.bytes_used;
+    total_usage.bytes_reserved += usage.bytes_reserved;
+  }
+  return !has_failed;
+}
+
+void PrintMemoryReport(const MemoryUsage& usage) {
+  std::cerr << "AST arena: " << usage.bytes_used << " bytes used, "
+            << usage.bytes_reserved << " bytes reserved" << std::endl;
+
+  auto resource_usage = rusage{};
+  if (getrusage(RUSAGE_SELF, &resource_usage) == 0) {
+    std::cerr << "Peak RSS: " << resource_usage.ru_maxrss << " KiB"
+              << std::endl;
+  }
+}
+
+}  // namespace
 
 int main(int argc, char* argv[]) try {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <filename>" << std::endl;
+  const auto options = frontend::ParseOptions(argc, argv);
+  if (!options) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--run | --interpret | [--emit=ll|bc|asm|obj] [-o <file>]]"
+                 " [--memory-report] [--stream] [--time-phases] [--stats]"
+                 " [--cache-dir=<dir> [--cache-size=<MiB>]]"
+                 " [--report-format=text|json]"
+                 " [-O0|-O1|-O2|-O3|--passes=<pipeline>]"
+                 " [-mcpu=<cpu>|-mcpu=native] [--short-circuit]"
+                 " [--no-vectorize] [--check-division]"
+                 " [--instrument[=<file>]]"
+                 " [--profile-use=<file>] [--jobs=<n>]"
+                 " <filename>... | @<response-file>\n"
+                 "       "
+              << argv[0]
+              << " --server[=<socket>] [-O0|-O1|-O2|-O3|--passes=<pipeline>]"
+                 " [-mcpu=<cpu>|-mcpu=native] [--short-circuit]"
+                 " [--no-vectorize] [--check-division]"
+                 " [--instrument[=<file>]]"
+                 " [--profile-use=<file>] [--jobs=<n>]"
+              << std::endl;
     return 1;
   }
 
-  auto driver = frontend::Driver{};
-  driver.Parse(argv[1]);
+  if (options->server) {
+    frontend::Serve(*options);
+    return 0;
+  }
 
-  auto* program = driver.get_program();
-  auto code_generator = frontend::CodeGenerator{};
-  program->Accept(code_generator);
+  auto session = frontend::Session{options->target_cpu};
+  auto cache = std::optional<frontend::Cache>{};
+  if (!options->cache_dir.empty()) {
+    cache.emplace(options->cache_dir, options->cache_max_bytes);
+  }
+  auto* const cache_ptr = cache ? &*cache : nullptr;
+  auto usage = MemoryUsage{};
+  auto status = 0;
+  if (options->filenames.size() > 1) {
+    status = CompileBatch(*options, session, cache_ptr, usage) ? 0 : 1;
+  } else {
+    const auto& filename = options->filenames.front();
+    try {
+      status = CompileFile(*options, session, cache_ptr, filename,
+                           options->output.value_or("-"), usage);
+    } catch (...) {
+      std::cerr << DescribeError(filename) << std::endl;
+      return 1;
+    }
+  }
 
-  code_generator.Print();
-  return 0;
+  if (options->memory_report) {
+    PrintMemoryReport(usage);
+  }
+  return status;
 } catch (const std::exception& e) {
   std::cerr << e.what() << std::endl;
   return 1;
@@ -1,128 +1,320 @@
 #pragma once
 
-#include <memory>
-#include <string>
-#include <vector>
+#include <cstdint>
+#include <span>
 
-#include "code_generator.h"
+// clang-format off
+#include "llvm/Support/Casting.h"
+// clang-format on
+
+#include "symbol_table.h"
+#include "visitor.h"
 
 namespace frontend {
 
 class IStmt;
 class IExpr;
+class FunctionDef;
+
+// Statements of a block, stored contiguously in the NodeArena.
+using StmtList = std::span<IStmt* const>;
+// Arguments of a call, which the ConstantFolder replaces in place.
+using ExprList = std::span<IExpr*>;
+using ParamList = std::span<const Symbol>;
+using FunctionList = std::span<FunctionDef* const>;
+
+// Every node carries its kind instead of a vtable: Accept dispatches to the
+// visitor with a switch, passes that walk the AST without recursion switch on
+// the kind themselves, and llvm::isa, cast, and dyn_cast work on nodes
+// through their classof.
+enum class NodeKind : std::uint8_t {
+  kProgram,
+  kFunctionDef,
+  kAssignStmt,
+  kStoreStmt,
+  kArrayDeclStmt,
+  kIfStmt,
+  kWhileStmt,
+  kReturnStmt,
+  kBinaryExpr,
+  kUnaryExpr,
+  kVarExpr,
+  kNumberExpr,
+  kCallExpr,
+  kIndexExpr,
+  kLengthExpr,
+};
 
+// Nodes are allocated in a NodeArena and released all at once, so they hold
+// only trivially destructible members and are never deleted through a base.
 class INode {
- public:
-  virtual ~INode() = default;
+ protected:
+  explicit INode(const NodeKind kind) noexcept : kind_(kind) {}
+  ~INode() = default;
 
  public:
-  virtual void Accept(IVisitor& visitor) = 0;
+  NodeKind get_kind() const noexcept { return kind_; }
+
+  void Accept(IVisitor& visitor);
+
+ private:
+  NodeKind kind_;
 };
 
+// The top-level statements form the body of main; functions may be defined
+// between them and are called from anywhere in the program.
 class Program final : public INode {
-  std::vector<std::unique_ptr<IStmt>> stmts_;
+  StmtList stmts_;
+  FunctionList functions_;
 
  public:
-  Program(std::vector<std::unique_ptr<IStmt>>&& stmts)
-      : stmts_(std::move(stmts)) {}
+  Program(const StmtList stmts, const FunctionList functions)
+      : INode(NodeKind::kProgram), stmts_(stmts), functions_(functions) {}
+
+  StmtList get_stmts() const noexcept { return stmts_; }
+  void set_stmts(const StmtList stmts) noexcept { stmts_ = stmts; }
 
-  auto get_stmts_cbegin() const noexcept { return stmts_.cbegin(); }
-  auto get_stmts_begin() noexcept { return stmts_.begin(); }
-  auto get_stmts_cend() const noexcept { return stmts_.cend(); }
-  auto get_stmts_end() noexcept { return stmts_.end(); }
+  // In order of definition.
+  FunctionList get_functions() const noexcept { return functions_; }
 
  public:
-  void Accept(IVisitor& visitor) override { visitor.Visit(*this); }
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kProgram;
+  }
+};
+
+class FunctionDef final : public INode {
+  Symbol symbol_;
+  ParamList params_;
+  StmtList stmts_;
+  FunctionIndex index_ = kUnresolvedFunction;
+  Slot slot_count_ = 0;
+
+ public:
+  FunctionDef(const Symbol symbol, const ParamList params,
+              const StmtList stmts)
+      : INode(NodeKind::kFunctionDef),
+        symbol_(symbol),
+        params_(params),
+        stmts_(stmts) {}
+
+  Symbol get_symbol() const noexcept { return symbol_; }
+
+  // The parameters take the first slots, in order.
+  ParamList get_params() const noexcept { return params_; }
+
+  StmtList get_stmts() const noexcept { return stmts_; }
+  void set_stmts(const StmtList stmts) noexcept { stmts_ = stmts; }
+
+  FunctionIndex get_index() const noexcept { return index_; }
+  void set_index(const FunctionIndex index) noexcept { index_ = index; }
+
+  Slot get_slot_count() const noexcept { return slot_count_; }
+  void set_slot_count(const Slot count) noexcept { slot_count_ = count; }
+
+ public:
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kFunctionDef;
+  }
 };
 
 class IStmt : public INode {
+ protected:
+  explicit IStmt(const NodeKind kind) noexcept : INode(kind) {}
+  ~IStmt() = default;
+
  public:
-  virtual ~IStmt() = default;
+  static bool classof(const INode* node) {
+    return node->get_kind() >= NodeKind::kAssignStmt &&
+           node->get_kind() <= NodeKind::kReturnStmt;
+  }
 };
 
 class AssignStmt final : public IStmt {
-  std::string name_;
-  std::unique_ptr<IExpr> expr_;
+  Symbol symbol_;
+  Slot slot_ = kUnresolvedSlot;
+  IExpr* expr_;
 
  public:
-  AssignStmt(std::string&& name, std::unique_ptr<IExpr>&& expr)
-      : name_(std::move(name)), expr_(std::move(expr)) {}
+  AssignStmt(const Symbol symbol, IExpr* const expr)
+      : IStmt(NodeKind::kAssignStmt), symbol_(symbol), expr_(expr) {}
 
-  const std::string& get_name() const noexcept { return name_; }
+  Symbol get_symbol() const noexcept { return symbol_; }
+
+  Slot get_slot() const noexcept { return slot_; }
+  void set_slot(const Slot slot) noexcept { slot_ = slot; }
 
   const IExpr& get_expr() const noexcept { return *expr_; }
   IExpr& get_expr() noexcept { return *expr_; }
+  void set_expr(IExpr* const expr) noexcept { expr_ = expr; }
+
+ public:
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kAssignStmt;
+  }
+};
+
+// Stores into an element of an array: `array[index] = expr;`.
+class StoreStmt final : public IStmt {
+  Symbol symbol_;
+  Slot slot_ = kUnresolvedSlot;
+  std::int64_t length_ = 0;
+  IExpr* index_;
+  IExpr* expr_;
+
+ public:
+  StoreStmt(const Symbol symbol, IExpr* const index, IExpr* const expr)
+      : IStmt(NodeKind::kStoreStmt),
+        symbol_(symbol),
+        index_(index),
+        expr_(expr) {}
+
+  Symbol get_symbol() const noexcept { return symbol_; }
+
+  Slot get_slot() const noexcept { return slot_; }
+  void set_slot(const Slot slot) noexcept { slot_ = slot; }
+
+  // The length of the array, which bounds the index.
+  std::int64_t get_length() const noexcept { return length_; }
+  void set_length(const std::int64_t length) noexcept { length_ = length; }
+
+  const IExpr& get_index() const noexcept { return *index_; }
+  IExpr& get_index() noexcept { return *index_; }
+  void set_index(IExpr* const index) noexcept { index_ = index; }
+
+  const IExpr& get_expr() const noexcept { return *expr_; }
+  IExpr& get_expr() noexcept { return *expr_; }
+  void set_expr(IExpr* const expr) noexcept { expr_ = expr; }
+
+ public:
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kStoreStmt;
+  }
+};
+
+// Declares an array of `length` zeros in the current scope, shadowing any
+// visible variable of the same name: `array name[length];`.
+class ArrayDeclStmt final : public IStmt {
+  Symbol symbol_;
+  Slot slot_ = kUnresolvedSlot;
+  std::int64_t length_;
+
+ public:
+  // Arrays are fixed in the frame of their function, so their size is
+  // bounded to keep frames within the native stack.
+  static constexpr std::int64_t kMaxLength = std::int64_t{1} << 16;
+
+  ArrayDeclStmt(const Symbol symbol, const std::int64_t length)
+      : IStmt(NodeKind::kArrayDeclStmt), symbol_(symbol), length_(length) {}
+
+  Symbol get_symbol() const noexcept { return symbol_; }
+
+  Slot get_slot() const noexcept { return slot_; }
+  void set_slot(const Slot slot) noexcept { slot_ = slot; }
+
+  std::int64_t get_length() const noexcept { return length_; }
 
  public:
-  void Accept(IVisitor& visitor) override { visitor.Visit(*this); }
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kArrayDeclStmt;
+  }
 };
 
 class IfStmt final : public IStmt {
-  std::unique_ptr<IExpr> cond_;
-  std::vector<std::unique_ptr<IStmt>> then_stmts_, else_stmts_;
+  IExpr* cond_;
+  StmtList then_stmts_, else_stmts_;
 
  public:
-  IfStmt(std::unique_ptr<IExpr>&& cond,
-         std::vector<std::unique_ptr<IStmt>>&& then_stmts,
-         std::vector<std::unique_ptr<IStmt>>&& else_stmts)
-      : cond_(std::move(cond)),
-        then_stmts_(std::move(then_stmts)),
-        else_stmts_(std::move(else_stmts)) {}
+  IfStmt(IExpr* const cond, const StmtList then_stmts,
+         const StmtList else_stmts)
+      : IStmt(NodeKind::kIfStmt),
+        cond_(cond),
+        then_stmts_(then_stmts),
+        else_stmts_(else_stmts) {}
 
   const IExpr& get_cond() const noexcept { return *cond_; }
   IExpr& get_cond() noexcept { return *cond_; }
+  void set_cond(IExpr* const cond) noexcept { cond_ = cond; }
 
-  auto get_then_cbegin() const noexcept { return then_stmts_.cbegin(); }
-  auto get_then_begin() noexcept { return then_stmts_.begin(); }
-  auto get_then_cend() const noexcept { return then_stmts_.cend(); }
-  auto get_then_end() noexcept { return then_stmts_.end(); }
+  StmtList get_then_stmts() const noexcept { return then_stmts_; }
+  void set_then_stmts(const StmtList stmts) noexcept { then_stmts_ = stmts; }
 
-  auto get_else_cbegin() const noexcept { return else_stmts_.cbegin(); }
-  auto get_else_begin() noexcept { return else_stmts_.begin(); }
-  auto get_else_cend() const noexcept { return else_stmts_.cend(); }
-  auto get_else_end() noexcept { return else_stmts_.end(); }
+  StmtList get_else_stmts() const noexcept { return else_stmts_; }
+  void set_else_stmts(const StmtList stmts) noexcept { else_stmts_ = stmts; }
 
  public:
-  void Accept(IVisitor& visitor) override { visitor.Visit(*this); }
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kIfStmt;
+  }
+};
+
+// What the annotations before a while statement ask of LLVM's loop passes;
+// zero leaves the decision to them.
+struct LoopHints final {
+  static constexpr std::int64_t kMaxUnroll = 1024;
+  static constexpr std::int64_t kMaxVectorizeWidth = 64;
+
+  // #unroll(n): unroll n times, or not at all if n is 1.
+  std::int64_t unroll = 0;
+  // #vectorize, or #vectorize(n) to vectorize with n lanes.
+  bool vectorize = false;
+  std::int64_t vectorize_width = 0;
 };
 
 class WhileStmt final : public IStmt {
-  std::unique_ptr<IExpr> cond_;
-  std::vector<std::unique_ptr<IStmt>> stmts_;
+  IExpr* cond_;
+  StmtList stmts_;
+  LoopHints hints_;
 
  public:
-  WhileStmt(std::unique_ptr<IExpr>&& cond,
-            std::vector<std::unique_ptr<IStmt>>&& stmts)
-      : cond_(std::move(cond)), stmts_(std::move(stmts)) {}
+  WhileStmt(IExpr* const cond, const StmtList stmts,
+            const LoopHints hints = {})
+      : IStmt(NodeKind::kWhileStmt),
+        cond_(cond),
+        stmts_(stmts),
+        hints_(hints) {}
 
   const IExpr& get_cond() const noexcept { return *cond_; }
   IExpr& get_cond() noexcept { return *cond_; }
+  void set_cond(IExpr* const cond) noexcept { cond_ = cond; }
+
+  StmtList get_stmts() const noexcept { return stmts_; }
+  void set_stmts(const StmtList stmts) noexcept { stmts_ = stmts; }
 
-  auto get_stmts_cbegin() const noexcept { return stmts_.cbegin(); }
-  auto get_stmts_begin() noexcept { return stmts_.begin(); }
-  auto get_stmts_cend() const noexcept { return stmts_.cend(); }
-  auto get_stmts_end() noexcept { return stmts_.end(); }
+  const LoopHints& get_hints() const noexcept { return hints_; }
 
  public:
-  void Accept(IVisitor& visitor) override { visitor.Visit(*this); }
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kWhileStmt;
+  }
 };
 
 class ReturnStmt final : public IStmt {
-  std::unique_ptr<IExpr> expr_;
+  IExpr* expr_;
 
  public:
-  ReturnStmt(std::unique_ptr<IExpr>&& expr) : expr_(std::move(expr)) {}
+  ReturnStmt(IExpr* const expr)
+      : IStmt(NodeKind::kReturnStmt), expr_(expr) {}
 
   const IExpr& get_expr() const noexcept { return *expr_; }
   IExpr& get_expr() noexcept { return *expr_; }
+  void set_expr(IExpr* const expr) noexcept { expr_ = expr; }
 
  public:
-  void Accept(IVisitor& visitor) override { visitor.Visit(*this); }
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kReturnStmt;
+  }
 };
 
 class IExpr : public INode {
+ protected:
+  explicit IExpr(const NodeKind kind) noexcept : INode(kind) {}
+  ~IExpr() = default;
+
  public:
-  virtual ~IExpr() = default;
+  static bool classof(const INode* node) {
+    return node->get_kind() >= NodeKind::kBinaryExpr;
+  }
 };
 
 class BinaryExpr final : public IExpr {
@@ -143,23 +335,26 @@ class BinaryExpr final : public IExpr {
     kAnd,
   };
 
-  BinaryExpr(std::unique_ptr<IExpr>&& lhs, std::unique_ptr<IExpr>&& rhs,
-             const Op op)
-      : lhs_(std::move(lhs)), rhs_(std::move(rhs)), op_(op) {}
+  BinaryExpr(IExpr* const lhs, IExpr* const rhs, const Op op)
+      : IExpr(NodeKind::kBinaryExpr), lhs_(lhs), rhs_(rhs), op_(op) {}
 
   const IExpr& get_lhs() const noexcept { return *lhs_; }
   IExpr& get_lhs() noexcept { return *lhs_; }
+  void set_lhs(IExpr* const lhs) noexcept { lhs_ = lhs; }
 
   const IExpr& get_rhs() const noexcept { return *rhs_; }
   IExpr& get_rhs() noexcept { return *rhs_; }
+  void set_rhs(IExpr* const rhs) noexcept { rhs_ = rhs; }
 
   Op get_op() const noexcept { return op_; }
 
  public:
-  void Accept(IVisitor& visitor) override { visitor.Visit(*this); }
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kBinaryExpr;
+  }
 
  private:
-  std::unique_ptr<IExpr> lhs_, rhs_;
+  IExpr *lhs_, *rhs_;
   Op op_;
 };
 
@@ -171,44 +366,195 @@ class UnaryExpr final : public IExpr {
   };
 
  public:
-  UnaryExpr(std::unique_ptr<IExpr>&& expr, const Op op)
-      : expr_(std::move(expr)), op_(op) {}
+  UnaryExpr(IExpr* const expr, const Op op)
+      : IExpr(NodeKind::kUnaryExpr), expr_(expr), op_(op) {}
 
   const IExpr& get_expr() const noexcept { return *expr_; }
   IExpr& get_expr() noexcept { return *expr_; }
+  void set_expr(IExpr* const expr) noexcept { expr_ = expr; }
 
   Op get_op() const noexcept { return op_; }
 
  public:
-  void Accept(IVisitor& visitor) override { visitor.Visit(*this); }
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kUnaryExpr;
+  }
 
  private:
-  std::unique_ptr<IExpr> expr_;
+  IExpr* expr_;
   Op op_;
 };
 
 class VarExpr final : public IExpr {
-  std::string name_;
+  Symbol symbol_;
+  Slot slot_ = kUnresolvedSlot;
 
  public:
-  VarExpr(std::string&& name) : name_(std::move(name)) {}
+  VarExpr(const Symbol symbol)
+      : IExpr(NodeKind::kVarExpr), symbol_(symbol) {}
+
+  Symbol get_symbol() const noexcept { return symbol_; }
 
-  const std::string& get_name() const noexcept { return name_; }
+  Slot get_slot() const noexcept { return slot_; }
+  void set_slot(const Slot slot) noexcept { slot_ = slot; }
 
  public:
-  void Accept(IVisitor& visitor) override { visitor.Visit(*this); }
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kVarExpr;
+  }
 };
 
 class NumberExpr final : public IExpr {
   std::int64_t value_;
 
  public:
-  NumberExpr(const std::int64_t value) : value_(value) {}
+  NumberExpr(const std::int64_t value)
+      : IExpr(NodeKind::kNumberExpr), value_(value) {}
 
   std::int64_t get_value() const noexcept { return value_; }
 
  public:
-  void Accept(IVisitor& visitor) override { visitor.Visit(*this); }
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kNumberExpr;
+  }
+};
+
+class CallExpr final : public IExpr {
+  Symbol symbol_;
+  FunctionIndex function_ = kUnresolvedFunction;
+  ExprList args_;
+
+ public:
+  CallExpr(const Symbol symbol, const ExprList args)
+      : IExpr(NodeKind::kCallExpr), symbol_(symbol), args_(args) {}
+
+  Symbol get_symbol() const noexcept { return symbol_; }
+
+  FunctionIndex get_function() const noexcept { return function_; }
+  void set_function(const FunctionIndex index) noexcept { function_ = index; }
+
+  ExprList get_args() const noexcept { return args_; }
+
+ public:
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kCallExpr;
+  }
 };
 
+// Reads an element of an array: `array[index]`. An index outside the array
+// traps in the generated code and is an error in the interpreter.
+class IndexExpr final : public IExpr {
+  Symbol symbol_;
+  Slot slot_ = kUnresolvedSlot;
+  std::int64_t length_ = 0;
+  IExpr* index_;
+
+ public:
+  IndexExpr(const Symbol symbol, IExpr* const index)
+      : IExpr(NodeKind::kIndexExpr), symbol_(symbol), index_(index) {}
+
+  Symbol get_symbol() const noexcept { return symbol_; }
+
+  Slot get_slot() const noexcept { return slot_; }
+  void set_slot(const Slot slot) noexcept { slot_ = slot; }
+
+  std::int64_t get_length() const noexcept { return length_; }
+  void set_length(const std::int64_t length) noexcept { length_ = length; }
+
+  const IExpr& get_index() const noexcept { return *index_; }
+  IExpr& get_index() noexcept { return *index_; }
+  void set_index(IExpr* const index) noexcept { index_ = index; }
+
+ public:
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kIndexExpr;
+  }
+};
+
+// The number of elements of an array, `len(array)`, a constant that the
+// ConstantFolder replaces by a number.
+class LengthExpr final : public IExpr {
+  Symbol symbol_;
+  std::int64_t length_ = 0;
+
+ public:
+  LengthExpr(const Symbol symbol)
+      : IExpr(NodeKind::kLengthExpr), symbol_(symbol) {}
+
+  Symbol get_symbol() const noexcept { return symbol_; }
+
+  std::int64_t get_length() const noexcept { return length_; }
+  void set_length(const std::int64_t length) noexcept { length_ = length; }
+
+ public:
+  static bool classof(const INode* node) {
+    return node->get_kind() == NodeKind::kLengthExpr;
+  }
+};
+
+inline void INode::Accept(IVisitor& visitor) {
+  switch (kind_) {
+    case NodeKind::kProgram: {
+      visitor.Visit(*llvm::cast<Program>(this));
+      break;
+    }
+    case NodeKind::kFunctionDef: {
+      visitor.Visit(*llvm::cast<FunctionDef>(this));
+      break;
+    }
+    case NodeKind::kAssignStmt: {
+      visitor.Visit(*llvm::cast<AssignStmt>(this));
+      break;
+    }
+    case NodeKind::kStoreStmt: {
+      visitor.Visit(*llvm::cast<StoreStmt>(this));
+      break;
+    }
+    case NodeKind::kArrayDeclStmt: {
+      visitor.Visit(*llvm::cast<ArrayDeclStmt>(this));
+      break;
+    }
+    case NodeKind::kIfStmt: {
+      visitor.Visit(*llvm::cast<IfStmt>(this));
+      break;
+    }
+    case NodeKind::kWhileStmt: {
+      visitor.Visit(*llvm::cast<WhileStmt>(this));
+      break;
+    }
+    case NodeKind::kReturnStmt: {
+      visitor.Visit(*llvm::cast<ReturnStmt>(this));
+      break;
+    }
+    case NodeKind::kBinaryExpr: {
+      visitor.Visit(*llvm::cast<BinaryExpr>(this));
+      break;
+    }
+    case NodeKind::kUnaryExpr: {
+      visitor.Visit(*llvm::cast<UnaryExpr>(this));
+      break;
+    }
+    case NodeKind::kVarExpr: {
+      visitor.Visit(*llvm::cast<VarExpr>(this));
+      break;
+    }
+    case NodeKind::kNumberExpr: {
+      visitor.Visit(*llvm::cast<NumberExpr>(this));
+      break;
+    }
+    case NodeKind::kCallExpr: {
+      visitor.Visit(*llvm::cast<CallExpr>(this));
+      break;
+    }
+    case NodeKind::kIndexExpr: {
+      visitor.Visit(*llvm::cast<IndexExpr>(this));
+      break;
+    }
+    case NodeKind::kLengthExpr: {
+      visitor.Visit(*llvm::cast<LengthExpr>(this));
+      break;
+    }
+  }
+}
+
 }  // namespace frontend
@@ -0,0 +1,208 @@
+#include "options.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+// clang-format off
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/StringSaver.h"
+// clang-format on
+
+#include "profile.h"
+
+namespace frontend {
+
+namespace {
+
+constexpr std::string_view kPassesPrefix = "--passes=";
+constexpr std::string_view kEmitPrefix = "--emit=";
+constexpr std::string_view kTargetCpuPrefix = "-mcpu=";
+constexpr std::string_view kJobsPrefix = "--jobs=";
+constexpr std::string_view kServerPrefix = "--server=";
+constexpr std::string_view kReportFormatPrefix = "--report-format=";
+constexpr std::string_view kCacheDirPrefix = "--cache-dir=";
+constexpr std::string_view kCacheSizePrefix = "--cache-size=";
+constexpr std::string_view kInstrumentPrefix = "--instrument=";
+constexpr std::string_view kProfileUsePrefix = "--profile-use=";
+
+// Where an instrumented program writes its profile unless told otherwise.
+constexpr std::string_view kDefaultProfile = "paraparacl.profile";
+
+// Parses a positive decimal number.
+template <typename T>
+std::optional<T> ParseCount(const std::string_view count) {
+  auto value = T{0};
+  const auto* const end = count.data() + count.size();
+  const auto [ptr, error] = std::from_chars(count.data(), end, value);
+  if (error != std::errc{} || ptr != end || value == 0) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+}  // namespace
+
+std::optional<Options> ParseOptions(const int argc, char* argv[]) {
+  // "@file" arguments are replaced by the whitespace-separated arguments
+  // stored in the file, so large batches don't hit the command line limit.
+  auto allocator = llvm::BumpPtrAllocator{};
+  auto saver = llvm::StringSaver{allocator};
+  auto args = llvm::SmallVector<const char*, 0>{argv, argv + argc};
+  if (!llvm::cl::ExpandResponseFiles(saver, llvm::cl::TokenizeGNUCommandLine,
+                                     args)) {
+    return std::nullopt;
+  }
+
+  auto options = Options{};
+  for (auto i = std::size_t{1}; i < args.size(); ++i) {
+    const auto arg = std::string_view{args[i]};
+    if (arg == "--run") {
+      options.run = true;
+    } else if (arg == "--interpret") {
+      options.interpret = true;
+    } else if (arg == "--memory-report") {
+      options.memory_report = true;
+    } else if (arg == "--stream") {
+      options.stream = true;
+    } else if (arg == "--time-phases") {
+      options.time_phases = true;
+    } else if (arg == "--stats") {
+      options.stats = true;
+    } else if (arg.starts_with(kReportFormatPrefix)) {
+      const auto format = arg.substr(kReportFormatPrefix.size());
+      if (format == "text") {
+        options.report_format = ReportFormat::kText;
+      } else if (format == "json") {
+        options.report_format = ReportFormat::kJson;
+      } else {
+        return std::nullopt;
+      }
+    } else if (arg == "--short-circuit") {
+      options.codegen.short_circuit = true;
+    } else if (arg == "--no-vectorize") {
+      options.codegen.vectorize = false;
+    } else if (arg == "--check-division") {
+      options.codegen.check_division = true;
+    } else if (arg == "--instrument") {
+      options.codegen.instrument = kDefaultProfile;
+    } else if (arg.starts_with(kInstrumentPrefix) &&
+               arg.size() > kInstrumentPrefix.size()) {
+      options.codegen.instrument = arg.substr(kInstrumentPrefix.size());
+    } else if (arg.starts_with(kProfileUsePrefix) &&
+               arg.size() > kProfileUsePrefix.size()) {
+      // Read once, however many programs use it.
+      options.codegen.profile = std::make_shared<const Profile>(
+          std::string{arg.substr(kProfileUsePrefix.size())});
+    } else if (arg == "-O0") {
+      options.pipeline.clear();
+    } else if (arg == "-O1" || arg == "-O2" || arg == "-O3") {
+      options.pipeline = "default<" + std::string{arg.substr(1)} + ">";
+    } else if (arg.starts_with(kPassesPrefix)) {
+      options.pipeline = arg.substr(kPassesPrefix.size());
+    } else if (arg.starts_with(kEmitPrefix)) {
+      options.emit_kind = ParseEmitKind(arg.substr(kEmitPrefix.size()));
+      if (!options.emit_kind) {
+        return std::nullopt;
+      }
+    } else if (arg.starts_with(kTargetCpuPrefix) &&
+               arg.size() > kTargetCpuPrefix.size()) {
+      options.target_cpu = arg.substr(kTargetCpuPrefix.size());
+    } else if (arg.starts_with(kJobsPrefix)) {
+      const auto jobs = ParseCount<unsigned>(arg.substr(kJobsPrefix.size()));
+      if (!jobs) {
+        return std::nullopt;
+      }
+      options.jobs = *jobs;
+    } else if (arg.starts_with(kCacheDirPrefix) &&
+               arg.size() > kCacheDirPrefix.size()) {
+      options.cache_dir = arg.substr(kCacheDirPrefix.size());
+    } else if (arg.starts_with(kCacheSizePrefix)) {
+      // In MiB, small enough not to overflow once shifted.
+      const auto megabytes =
+          ParseCount<std::uint32_t>(arg.substr(kCacheSizePrefix.size()));
+      if (!megabytes) {
+        return std::nullopt;
+      }
+      options.cache_max_bytes = std::uint64_t{*megabytes} << 20;
+    } else if (arg == "--server") {
+      options.server = true;
+    } else if (arg.starts_with(kServerPrefix) &&
+               arg.size() > kServerPrefix.size()) {
+      options.server = true;
+      options.socket_path = arg.substr(kServerPrefix.size());
+    } else if (arg == "-o" && i + 1 < args.size()) {
+      options.output = args[++i];
+    } else if (!arg.starts_with('-')) {
+      options.filenames.emplace_back(arg);
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  // A server takes its programs and output kinds from requests, which are
+  // small enough to be parsed whole.
+  if (options.server) {
+    if (options.run || options.interpret || options.memory_report ||
+        options.stream || !options.cache_dir.empty() ||
+        options.time_phases || options.stats || options.emit_kind ||
+        options.output || !options.filenames.empty()) {
+      return std::nullopt;
+    }
+    return options;
+  }
+
+  // Running in-process doesn't produce an output file, every input of a
+  // batch is written next to its source, and a report describes one
+  // compilation. The interpreter numbers its temporaries after the variables,
+  // so it needs the whole program resolved first and can't stream, and it
+  // doesn't count. Only output files are cached.
+  const auto is_running = options.run || options.interpret;
+  const auto is_reporting = options.time_phases || options.stats;
+  if (options.filenames.empty() || (options.run && options.interpret) ||
+      (options.interpret &&
+       (options.stream || !options.codegen.instrument.empty())) ||
+      (is_running &&
+       (options.emit_kind || options.output || !options.cache_dir.empty())) ||
+      (options.filenames.size() > 1 &&
+       (is_running || is_reporting || options.output))) {
+    return std::nullopt;
+  }
+
+  // A batch compiles its files in parallel, and a single file its
+  // functions.
+  if (options.filenames.size() == 1) {
+    options.codegen.jobs = GetJobCount(options);
+  }
+  return options;
+}
+
+std::optional<EmitKind> ParseEmitKind(const std::string_view kind) {
+  if (kind == "ll") {
+    return EmitKind::kIr;
+  }
+  if (kind == "bc") {
+    return EmitKind::kBitcode;
+  }
+  if (kind == "asm") {
+    return EmitKind::kAssembly;
+  }
+  if (kind == "obj") {
+    return EmitKind::kObject;
+  }
+  return std::nullopt;
+}
+
+unsigned GetJobCount(const Options& options) {
+  if (options.jobs != 0) {
+    return options.jobs;
+  }
+  return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+}  // namespace frontend
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "code_generator.h"
+#include "statistics.h"
+
+namespace frontend {
+
+struct Options final {
+  bool run = false;
+  // Runs the program on the bytecode interpreter instead of the JIT.
+  bool interpret = false;
+  bool memory_report = false;
+  // Lowers every top-level statement as soon as it's parsed and releases its
+  // nodes, instead of building the whole AST first.
+  bool stream = false;
+  // Reports the time of every phase and the counters on stderr after a
+  // compilation.
+  bool time_phases = false;
+  bool stats = false;
+  ReportFormat report_format = ReportFormat::kText;
+  std::string pipeline;
+  CodeGenOptions codegen;
+  std::optional<EmitKind> emit_kind;
+  std::optional<std::string> output;
+  std::string target_cpu;
+  // Reuses outputs stored in the cache directory, if one is given, instead of
+  // compiling sources it has seen with the same options.
+  std::string cache_dir;
+  std::uint64_t cache_max_bytes = std::uint64_t{256} << 20;
+  // Zero selects one job per hardware thread.
+  unsigned jobs = 0;
+  // Serves requests from stdin, or from a Unix domain socket if a socket path
+  // is given, instead of compiling files.
+  bool server = false;
+  std::string socket_path;
+  std::vector<std::string> filenames;
+};
+
+// Parses the command line, expanding "@file" response files, and reads the
+// profile to use. Returns nothing if the arguments are invalid or
+// inconsistent, and throws if the profile can't be read.
+std::optional<Options> ParseOptions(int argc, char* argv[]);
+
+std::optional<EmitKind> ParseEmitKind(std::string_view kind);
+
+// Returns the number of worker threads to use.
+unsigned GetJobCount(const Options& options);
+
+}  // namespace frontend
@@ -0,0 +1,48 @@
+#include "paraparacl.h"
+
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+
+// clang-format off
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/raw_ostream.h"
+// clang-format on
+
+#include "compiler.h"
+#include "driver.h"
+
+namespace frontend {
+
+CompileResult CompileSource(Session& session, const std::string_view source,
+                            const SourceOptions& options) {
+  auto result = CompileResult{};
+  try {
+    auto driver = Driver{};
+    driver.ParseBuffer(source, options.name);
+
+    auto code_generator =
+        CodeGenerator{driver.get_symbols(), session, options.codegen};
+    Compile(driver, code_generator, options.pipeline);
+    if (!options.emit_kind) {
+      result.module = code_generator.TakeModule();
+      return result;
+    }
+
+    auto output = llvm::SmallString<0>{};
+    auto stream = llvm::raw_svector_ostream{output};
+    code_generator.Emit(*options.emit_kind, stream);
+    result.output = output.str().str();
+  } catch (const SyntaxError& e) {
+    result.diagnostics.push_back(e.get_diagnostic());
+  } catch (const std::bad_alloc&) {
+    throw;
+  } catch (const std::exception& e) {
+    result.diagnostics.push_back(
+        Diagnostic{.message = e.what(), .range = std::nullopt});
+  }
+  return result;
+}
+
+}  // namespace frontend
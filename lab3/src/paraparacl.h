@@ -0,0 +1,56 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// clang-format off
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+// clang-format on
+
+#include "code_generator.h"
+#include "diagnostic.h"
+#include "session.h"
+
+namespace frontend {
+
+// The API of libparaparacl, for programs that embed the compiler: a source
+// held in memory goes in, and a module or its emitted form comes out along
+// with the diagnostics, without files, processes, or exceptions for errors in
+// the program. A service keeps a Session per thread and compiles every source
+// in it, which saves creating a target machine and a JIT for each. Every
+// compilation has an LLVM context of its own, which the result owns, so
+// memory doesn't grow with the number of compilations: it's released with the
+// result, or by Session::Run.
+
+struct SourceOptions final {
+  // Names the source in syntax errors.
+  std::string name = "<source>";
+  // A textual pipeline as for CodeGenerator::Optimize; an empty one leaves
+  // the module as it's lowered.
+  std::string pipeline;
+  CodeGenOptions codegen;
+  // Emits the module in this form to the output instead of handing it over.
+  std::optional<EmitKind> emit_kind;
+};
+
+struct CompileResult final {
+  // The module and the context it lives in, unless the compilation failed or
+  // the module was emitted. Session::Run runs it.
+  OwnedModule module;
+  // The emitted module, if an emit kind was given.
+  std::string output;
+  // Empty if and only if the compilation succeeded.
+  std::vector<Diagnostic> diagnostics;
+};
+
+// Compiles the source in the session. The source is only read during the
+// call, and the module doesn't refer to it. Errors in the program and those
+// of LLVM, such as an invalid pipeline, become diagnostics; only running out
+// of memory throws.
+CompileResult CompileSource(Session& session, std::string_view source,
+                            const SourceOptions& options = {});
+
+}  // namespace frontend
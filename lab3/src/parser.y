@@ -38,22 +38,27 @@ class Scanner;
 %code top {
 
 #include <sstream>
-#include <memory>
 
 #include "driver.h"
 
-#define yylex scanner.Get
+#define yylex() driver.NextToken(scanner)
 
 }
 
-%token <std::string>   IDENT   "identifier";
-%token <std::int64_t>  NUMBER  "number";
+%token <frontend::Symbol> IDENT "identifier";
+%token <std::int64_t> NUMBER "number";
 
 %token
   IF      "if"
   ELSE    "else"
   WHILE   "while"
   RETURN  "return"
+  FUNC    "func"
+  ARRAY   "array"
+  LEN     "len"
+
+  UNROLL     "#unroll"
+  VECTORIZE  "#vectorize"
 
   ASSIGN     "="
   COMMA      ","
@@ -63,6 +68,8 @@ class Scanner;
   RIGHT_PARENTHESIS    ")"
   LEFT_CURLY_BRACKET   "{"
   RIGHT_CURLY_BRACKET  "}"
+  LEFT_SQUARE_BRACKET  "["
+  RIGHT_SQUARE_BRACKET "]"
 
 %nonassoc
   CMP_OP
@@ -90,13 +97,23 @@ class Scanner;
   UN_OP
   EXCLAMATORY  "!"
 
-%nterm <std::vector<std::unique_ptr<frontend::IStmt>>> stmts
-%nterm <std::unique_ptr<frontend::IStmt>> stmt
-%nterm <std::unique_ptr<frontend::AssignStmt>> assign_stmt
-%nterm <std::unique_ptr<frontend::IfStmt>> if_stmt
-%nterm <std::unique_ptr<frontend::WhileStmt>> while_stmt
-%nterm <std::unique_ptr<frontend::ReturnStmt>> return_stmt
-%nterm <std::unique_ptr<frontend::IExpr>> expr
+%nterm <frontend::StmtList> block
+%nterm <std::size_t> program_items
+%nterm <frontend::FunctionDef*> function_def
+%nterm <frontend::ParamList> params
+%nterm <std::size_t> param_list
+%nterm <std::size_t> stmts
+%nterm <frontend::IStmt*> stmt
+%nterm <frontend::AssignStmt*> assign_stmt
+%nterm <frontend::StoreStmt*> store_stmt
+%nterm <frontend::ArrayDeclStmt*> array_decl_stmt
+%nterm <frontend::IfStmt*> if_stmt
+%nterm <frontend::WhileStmt*> while_stmt
+%nterm <frontend::LoopHints> loop_hints
+%nterm <frontend::ReturnStmt*> return_stmt
+%nterm <frontend::IExpr*> expr
+%nterm <frontend::ExprList> args
+%nterm <std::size_t> arg_list
 %nterm <frontend::BinaryExpr::Op> cmp_op
 %nterm <frontend::BinaryExpr::Op> add_op
 %nterm <frontend::BinaryExpr::Op> mul_op
@@ -105,24 +122,86 @@ class Scanner;
 %%
 
 program:
-  stmts
+  program_items
+  {
+    driver.set_program(driver.Make<frontend::Program>(
+        driver.EndStmts($1), driver.EndFunctions()));
+  }
+
+program_items:
+  program_items stmt
+  {
+    $$ = $1;
+    driver.AddProgramStmt($2);
+  }
+| program_items function_def
+  {
+    $$ = $1;
+    driver.AddFunction($2);
+  }
+| %empty
+  {
+    $$ = driver.BeginStmts();
+  }
+
+function_def:
+  FUNC IDENT "(" params ")" block
+  {
+    $$ = driver.Make<frontend::FunctionDef>($2, $4, $6);
+  }
+
+params:
+  param_list
+  {
+    $$ = driver.EndParams($1);
+  }
+| %empty
   {
-    driver.set_program(std::make_unique<frontend::Program>($1));
+    $$ = frontend::ParamList{};
+  }
+
+param_list:
+  param_list "," IDENT
+  {
+    $$ = $1;
+    driver.AddParam($3);
+  }
+| IDENT
+  {
+    $$ = driver.BeginParams();
+    driver.AddParam($1);
+  }
+
+block:
+  "{" stmts "}"
+  {
+    $$ = driver.EndStmts($2);
   }
 
 stmts:
   stmts stmt
   {
     $$ = $1;
-    $$.push_back($2);
+    driver.AddStmt($2);
+  }
+| %empty
+  {
+    $$ = driver.BeginStmts();
   }
-| %empty { }
 
 stmt:
   assign_stmt
   {
     $$ = $1;
   }
+| store_stmt
+  {
+    $$ = $1;
+  }
+| array_decl_stmt
+  {
+    $$ = $1;
+  }
 | if_stmt
   {
     $$ = $1;
@@ -139,57 +218,150 @@ stmt:
 assign_stmt:
   IDENT "=" expr ";"
   {
-    $$ = std::make_unique<frontend::AssignStmt>($1, $3);
+    $$ = driver.Make<frontend::AssignStmt>($1, $3);
+  }
+
+store_stmt:
+  IDENT "[" expr "]" "=" expr ";"
+  {
+    $$ = driver.Make<frontend::StoreStmt>($1, $3, $6);
+  }
+
+array_decl_stmt:
+  ARRAY IDENT "[" NUMBER "]" ";"
+  {
+    $$ = driver.Make<frontend::ArrayDeclStmt>($2, $4);
   }
 
 if_stmt:
-  IF "(" expr ")" "{" stmts "}" ELSE "{" stmts "}"
+  IF "(" expr ")" block ELSE block
   {
-    $$ = std::make_unique<frontend::IfStmt>($3, $6, $10);
+    $$ = driver.Make<frontend::IfStmt>($3, $5, $7);
   }
 
 while_stmt:
-  WHILE "(" expr ")" "{" stmts "}"
-  {
-    $$ = std::make_unique<frontend::WhileStmt>($3, $6);
+  loop_hints WHILE "(" expr ")" block
+  {
+    $$ = driver.Make<frontend::WhileStmt>($4, $6, $1);
+  }
+
+loop_hints:
+  loop_hints UNROLL "(" NUMBER ")"
+  {
+    auto hints = $1;
+    const auto count = $4;
+    if (hints.unroll != 0) {
+      throw syntax_error(@2, "duplicate #unroll");
+    }
+    if (count < 1 || count > frontend::LoopHints::kMaxUnroll) {
+      throw syntax_error(
+          @4, "#unroll count must be 1 to " +
+                  std::to_string(frontend::LoopHints::kMaxUnroll));
+    }
+    hints.unroll = count;
+    $$ = hints;
+  }
+| loop_hints VECTORIZE
+  {
+    auto hints = $1;
+    if (hints.vectorize) {
+      throw syntax_error(@2, "duplicate #vectorize");
+    }
+    hints.vectorize = true;
+    $$ = hints;
+  }
+| loop_hints VECTORIZE "(" NUMBER ")"
+  {
+    auto hints = $1;
+    const auto width = $4;
+    if (hints.vectorize) {
+      throw syntax_error(@2, "duplicate #vectorize");
+    }
+    if (width < 2 || width > frontend::LoopHints::kMaxVectorizeWidth ||
+        (width & (width - 1)) != 0) {
+      throw syntax_error(
+          @4, "#vectorize width must be a power of two from 2 to " +
+                  std::to_string(frontend::LoopHints::kMaxVectorizeWidth));
+    }
+    hints.vectorize = true;
+    hints.vectorize_width = width;
+    $$ = hints;
+  }
+| %empty
+  {
+    $$ = frontend::LoopHints{};
   }
 
 return_stmt:
   RETURN expr ";"
   {
-    $$ = std::make_unique<frontend::ReturnStmt>($2);
+    $$ = driver.Make<frontend::ReturnStmt>($2);
   }
 
 expr:
   expr cmp_op expr %prec CMP_OP
   {
-    $$ = std::make_unique<frontend::BinaryExpr>($1, $3, $2);
+    $$ = driver.Make<frontend::BinaryExpr>($1, $3, $2);
   }
 | expr add_op expr %prec ADD_OP
   {
-    $$ = std::make_unique<frontend::BinaryExpr>($1, $3, $2);
+    $$ = driver.Make<frontend::BinaryExpr>($1, $3, $2);
   }
 | expr mul_op expr %prec MUL_OP
   {
-    $$ = std::make_unique<frontend::BinaryExpr>($1, $3, $2);
+    $$ = driver.Make<frontend::BinaryExpr>($1, $3, $2);
   }
 | un_op expr %prec UN_OP
   {
-    $$ = std::make_unique<frontend::UnaryExpr>($2, $1);
+    $$ = driver.Make<frontend::UnaryExpr>($2, $1);
+  }
+| IDENT "(" args ")"
+  {
+    $$ = driver.Make<frontend::CallExpr>($1, $3);
+  }
+| IDENT "[" expr "]"
+  {
+    $$ = driver.Make<frontend::IndexExpr>($1, $3);
+  }
+| LEN "(" IDENT ")"
+  {
+    $$ = driver.Make<frontend::LengthExpr>($3);
   }
 | IDENT
   {
-    $$ = std::make_unique<frontend::VarExpr>($1);
+    $$ = driver.Make<frontend::VarExpr>($1);
   }
 | NUMBER
   {
-    $$ = std::make_unique<frontend::NumberExpr>($1);
+    $$ = driver.Make<frontend::NumberExpr>($1);
   }
 | "(" expr ")"
   {
     $$ = $2;
   }
 
+args:
+  arg_list
+  {
+    $$ = driver.EndExprs($1);
+  }
+| %empty
+  {
+    $$ = frontend::ExprList{};
+  }
+
+arg_list:
+  arg_list "," expr
+  {
+    $$ = $1;
+    driver.AddExpr($3);
+  }
+| expr
+  {
+    $$ = driver.BeginExprs();
+    driver.AddExpr($1);
+  }
+
 cmp_op:
   EQUAL
   {
@@ -0,0 +1,73 @@
+#include "profile.h"
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+// clang-format off
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ProfileSummary.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+#include "llvm/Support/MemoryBuffer.h"
+// clang-format on
+
+namespace frontend {
+
+Profile::Profile(const std::string& filename) {
+  auto buffer = llvm::MemoryBuffer::getFile(filename, /*IsText=*/true);
+  if (!buffer) {
+    throw std::runtime_error("Failed to read the profile " + filename + ": " +
+                             buffer.getError().message());
+  }
+  contents_ = (*buffer)->getBuffer().str();
+
+  auto builder = llvm::InstrProfSummaryBuilder{
+      llvm::ProfileSummaryBuilder::DefaultCutoffs};
+  auto lines = llvm::SmallVector<llvm::StringRef, 0>{};
+  llvm::StringRef{contents_}.split(lines, '\n');
+  auto fields = llvm::SmallVector<llvm::StringRef, 8>{};
+  for (auto line_number = std::size_t{0}; line_number < lines.size();
+       ++line_number) {
+    fields.clear();
+    lines[line_number].split(fields, ' ', /*MaxSplit=*/-1,
+                             /*KeepEmpty=*/false);
+    if (fields.empty()) {
+      continue;
+    }
+
+    // A name, the entry count, and two counts per statement.
+    auto counts = std::vector<std::uint64_t>{};
+    auto is_malformed = fields.size() % 2 != 0;
+    for (auto i = std::size_t{1}; !is_malformed && i < fields.size(); ++i) {
+      is_malformed = fields[i].getAsInteger(10, counts.emplace_back());
+    }
+    if (is_malformed) {
+      throw std::runtime_error("Malformed profile " + filename + " at line " +
+                               std::to_string(line_number + 1));
+    }
+
+    builder.addRecord(llvm::InstrProfRecord{counts});
+    functions_[fields.front()] = std::move(counts);
+  }
+  summary_ = builder.getSummary();
+}
+
+Profile::~Profile() = default;
+
+const std::vector<std::uint64_t>* Profile::Find(
+    const std::string_view function) const {
+  const auto it =
+      functions_.find(llvm::StringRef{function.data(), function.size()});
+  return it != functions_.end() ? &it->second : nullptr;
+}
+
+void Profile::AddSummary(llvm::Module& module) const {
+  module.setProfileSummary(summary_->getMD(module.getContext()),
+                           llvm::ProfileSummary::PSK_Instr);
+}
+
+std::string_view Profile::get_contents() const noexcept { return contents_; }
+
+}  // namespace frontend
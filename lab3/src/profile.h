@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// clang-format off
+#include "llvm/ADT/StringMap.h"
+// clang-format on
+
+namespace llvm {
+class Module;
+class ProfileSummary;
+}  // namespace llvm
+
+namespace frontend {
+
+// Execution counts written by a program compiled with --instrument, one line
+// per function: its name, how often it was entered, and then two counts for
+// every if and while statement in the order they're lowered, how often the
+// then and else arms were taken, or the body of the loop and its exit.
+// Statements are identified by their position in their function, so a
+// profile survives recompiling the program and editing other functions.
+class Profile final {
+ public:
+  // Reads the profile. Throws if it can't be read or is malformed.
+  explicit Profile(const std::string& filename);
+  ~Profile();
+
+  // Returns the counts of the function, or nothing if it never ran.
+  const std::vector<std::uint64_t>* Find(std::string_view function) const;
+
+  // Adds the summary of all the counts to the module, which LLVM needs to
+  // tell hot functions and blocks from cold ones.
+  void AddSummary(llvm::Module& module) const;
+
+  // The profile as read, which determines the generated code.
+  std::string_view get_contents() const noexcept;
+
+ private:
+  std::string contents_;
+  llvm::StringMap<std::vector<std::uint64_t>> functions_;
+  std::unique_ptr<llvm::ProfileSummary> summary_;
+};
+
+}  // namespace frontend
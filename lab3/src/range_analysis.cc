@@ -0,0 +1,634 @@
+#include "range_analysis.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// clang-format off
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/ConstantRange.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/KnownBits.h"
+#include "llvm/Transforms/Utils/Local.h"
+// clang-format on
+
+namespace frontend {
+
+namespace {
+
+// The ranges are recomputed in passes over the function until they're
+// stable. Phis of loop headers are widened to the thresholds for the first
+// passes and then straight to the extremes, so that a function comparing
+// against many constants doesn't take a pass for each; a function that still
+// isn't stable after the last pass is left as it is.
+constexpr int kThresholdPasses = 4;
+constexpr int kMaxPasses = 16;
+// Decreasing passes that take back what widening overshot.
+constexpr int kNarrowingPasses = 2;
+// Functions with more instructions than this take every phi of a loop header
+// to have any value and are done in a single pass, since a pass over them
+// costs as much as lowering them.
+constexpr std::size_t kMaxIterativeSize = 10'000;
+// How deep conditions combined with eager && and || are looked into.
+constexpr int kMaxConditionDepth = 4;
+
+bool IsSignedLess(const llvm::APInt& lhs, const llvm::APInt& rhs) {
+  return lhs.slt(rhs);
+}
+
+class RangeAnalysis final {
+ public:
+  explicit RangeAnalysis(llvm::Function& function);
+
+  // Returns false if the ranges didn't become stable.
+  bool Run();
+  // Sets the flags and folds the comparisons the ranges decide.
+  void Apply();
+
+ private:
+  llvm::ConstantRange GetRange(const llvm::Value& value) const;
+  // The range of a value in `to` entered from `from`, narrowed by the
+  // branches on the way there.
+  llvm::ConstantRange GetRangeOnEdge(const llvm::Value& value,
+                                     const llvm::BasicBlock* from,
+                                     const llvm::BasicBlock* to);
+  // The range of a value at the end of `block`, narrowed by the branches up
+  // the chain of single predecessors above it.
+  llvm::ConstantRange GetRangeAtEnd(const llvm::Value& value,
+                                    const llvm::BasicBlock& block);
+  llvm::ConstantRange GetOperandRange(const llvm::Instruction& user,
+                                      unsigned index);
+  // Narrows the range of `value` by the branch from `from` to `to`.
+  llvm::ConstantRange Narrow(llvm::ConstantRange range,
+                             const llvm::Value& value,
+                             const llvm::BasicBlock& from,
+                             const llvm::BasicBlock& to) const;
+  // Narrows the range of `value` to where `condition` is `holds`.
+  llvm::ConstantRange Constrain(llvm::ConstantRange range,
+                                const llvm::Value& value,
+                                const llvm::Value& condition, bool holds,
+                                int depth) const;
+  llvm::ConstantRange Compute(const llvm::Instruction& inst);
+  llvm::ConstantRange Widen(const llvm::ConstantRange& old_range,
+                            const llvm::ConstantRange& new_range,
+                            bool has_thresholds) const;
+  // Whether the comparison always or never holds, if the ranges decide it.
+  std::optional<bool> Decide(const llvm::ICmpInst& compare);
+  bool IsNoSignedWrap(const llvm::BinaryOperator& binary);
+  bool IsExact(const llvm::BinaryOperator& division) const;
+  // Adds the values the condition compares to those that are tested.
+  void AddTested(const llvm::Value& condition, int depth);
+
+ private:
+  llvm::Function& function_;
+  // The reachable blocks in reverse post-order, so that every value but
+  // those flowing around loops is computed before it's used.
+  std::vector<llvm::BasicBlock*> blocks_;
+  llvm::DenseSet<const llvm::BasicBlock*> headers_;
+  bool is_iterative_ = true;
+  // The values compared by the conditions of branches, the only ones that
+  // are narrowed on their edges.
+  llvm::DenseSet<const llvm::Value*> tested_;
+  // The constants compared against and their neighbours, sorted.
+  std::vector<llvm::APInt> thresholds_;
+  llvm::DenseMap<const llvm::Value*, llvm::ConstantRange> ranges_;
+  // The ranges at the ends of blocks of the values that are tested, so that
+  // a long chain of blocks, such as the checks of a run of divisions, is
+  // walked once rather than from each of its blocks. It's emptied before
+  // every pass; within one, it's only stale for the values that flow around
+  // loops, which the next pass computes again.
+  llvm::DenseMap<std::pair<const llvm::Value*, const llvm::BasicBlock*>,
+                 llvm::ConstantRange>
+      ends_;
+};
+
+RangeAnalysis::RangeAnalysis(llvm::Function& function) : function_(function) {
+  auto order = llvm::DenseMap<const llvm::BasicBlock*, std::size_t>{};
+  auto size = std::size_t{0};
+  for (auto* const block :
+       llvm::ReversePostOrderTraversal<llvm::Function*>{&function}) {
+    order.try_emplace(block, blocks_.size());
+    blocks_.push_back(block);
+    size += block->size();
+  }
+  is_iterative_ = size <= kMaxIterativeSize;
+
+  const auto min = llvm::APInt::getSignedMinValue(64);
+  const auto max = llvm::APInt::getSignedMaxValue(64);
+  thresholds_ = {min, min + 1, max - 1, max};
+  for (auto* const block : blocks_) {
+    // A block entered from one that comes later, or from an unreachable
+    // one, heads a loop.
+    for (auto* const pred : llvm::predecessors(block)) {
+      const auto it = order.find(pred);
+      if (it == order.end() || it->second >= order.lookup(block)) {
+        headers_.insert(block);
+      }
+    }
+
+    const auto* const branch =
+        llvm::dyn_cast<llvm::BranchInst>(block->getTerminator());
+    if (branch != nullptr && branch->isConditional()) {
+      AddTested(*branch->getCondition(), 0);
+    }
+
+    for (const auto& inst : *block) {
+      const auto* const compare = llvm::dyn_cast<llvm::ICmpInst>(&inst);
+      if (compare == nullptr ||
+          !compare->getOperand(0)->getType()->isIntegerTy(64)) {
+        continue;
+      }
+      for (const auto& operand : compare->operands()) {
+        const auto* const constant = llvm::dyn_cast<llvm::ConstantInt>(operand);
+        if (constant == nullptr) {
+          continue;
+        }
+        const auto& value = constant->getValue();
+        thresholds_.push_back(value);
+        if (value != min) {
+          thresholds_.push_back(value - 1);
+        }
+        if (value != max) {
+          thresholds_.push_back(value + 1);
+        }
+      }
+    }
+  }
+  std::sort(thresholds_.begin(), thresholds_.end(), IsSignedLess);
+  thresholds_.erase(std::unique(thresholds_.begin(), thresholds_.end()),
+                    thresholds_.end());
+}
+
+bool RangeAnalysis::Run() {
+  for (auto pass = 0;; ++pass) {
+    if (pass == kMaxPasses) {
+      return false;
+    }
+
+    ends_.clear();
+    auto is_changed = false;
+    for (auto* const block : blocks_) {
+      const auto is_header = headers_.contains(block);
+      for (const auto& inst : *block) {
+        if (!inst.getType()->isIntegerTy()) {
+          continue;
+        }
+        const auto is_header_phi = is_header && llvm::isa<llvm::PHINode>(inst);
+        auto range = is_header_phi && !is_iterative_
+                         ? llvm::ConstantRange::getFull(
+                               inst.getType()->getIntegerBitWidth())
+                         : Compute(inst);
+        const auto it = ranges_.find(&inst);
+        if (it == ranges_.end()) {
+          ranges_.try_emplace(&inst, std::move(range));
+          is_changed = true;
+          continue;
+        }
+        if (is_header_phi) {
+          range = Widen(
+              it->second,
+              it->second.unionWith(range, llvm::ConstantRange::Signed),
+              pass < kThresholdPasses);
+        }
+        if (range != it->second) {
+          it->second = std::move(range);
+          is_changed = true;
+        }
+      }
+    }
+    // Without loops, or with their headers not followed around them, every
+    // value is computed after its operands, in one pass.
+    if (!is_changed || headers_.empty() || !is_iterative_) {
+      break;
+    }
+  }
+  if (headers_.empty() || !is_iterative_) {
+    ends_.clear();
+    return true;
+  }
+
+  for (auto pass = 0; pass < kNarrowingPasses; ++pass) {
+    ends_.clear();
+    for (auto* const block : blocks_) {
+      const auto is_header = headers_.contains(block);
+      for (const auto& inst : *block) {
+        if (!inst.getType()->isIntegerTy()) {
+          continue;
+        }
+        auto range = Compute(inst);
+        auto& old_range = ranges_.find(&inst)->second;
+        if (is_header && llvm::isa<llvm::PHINode>(inst)) {
+          range = range.intersectWith(old_range, llvm::ConstantRange::Signed);
+        }
+        old_range = std::move(range);
+      }
+    }
+  }
+  ends_.clear();
+  return true;
+}
+
+void RangeAnalysis::Apply() {
+  auto decided = std::vector<std::pair<llvm::ICmpInst*, bool>>{};
+  for (auto* const block : blocks_) {
+    for (auto& inst : *block) {
+      if (auto* const compare = llvm::dyn_cast<llvm::ICmpInst>(&inst)) {
+        if (const auto holds = Decide(*compare)) {
+          decided.emplace_back(compare, *holds);
+        }
+        continue;
+      }
+
+      auto* const binary = llvm::dyn_cast<llvm::BinaryOperator>(&inst);
+      if (binary == nullptr) {
+        continue;
+      }
+      switch (binary->getOpcode()) {
+        case llvm::Instruction::Add:
+        case llvm::Instruction::Sub:
+        case llvm::Instruction::Mul: {
+          if (IsNoSignedWrap(*binary)) {
+            binary->setHasNoSignedWrap();
+          }
+          break;
+        }
+        case llvm::Instruction::SDiv: {
+          if (IsExact(*binary)) {
+            binary->setIsExact();
+          }
+          break;
+        }
+        default: {
+          break;
+        }
+      }
+    }
+  }
+  if (decided.empty()) {
+    return;
+  }
+
+  // The users are collected before any is folded, since folding a branch
+  // deletes the instructions it made dead.
+  auto selects = std::vector<llvm::SelectInst*>{};
+  auto branches = std::vector<llvm::BasicBlock*>{};
+  auto dead = llvm::SmallVector<llvm::WeakTrackingVH, 16>{};
+  for (const auto& [compare, holds] : decided) {
+    for (auto* const user : compare->users()) {
+      if (auto* const select = llvm::dyn_cast<llvm::SelectInst>(user)) {
+        selects.push_back(select);
+      } else if (llvm::isa<llvm::BranchInst>(user)) {
+        branches.push_back(llvm::cast<llvm::BranchInst>(user)->getParent());
+      }
+    }
+    compare->replaceAllUsesWith(
+        llvm::ConstantInt::getBool(compare->getType(), holds));
+    dead.emplace_back(compare);
+  }
+  for (auto* const select : selects) {
+    const auto* const condition =
+        llvm::dyn_cast<llvm::ConstantInt>(select->getCondition());
+    if (condition == nullptr) {
+      continue;
+    }
+    select->replaceAllUsesWith(condition->isOne() ? select->getTrueValue()
+                                                  : select->getFalseValue());
+    dead.emplace_back(select);
+  }
+  for (auto* const block : branches) {
+    llvm::ConstantFoldTerminator(block);
+  }
+  if (!branches.empty()) {
+    llvm::removeUnreachableBlocks(function_);
+  }
+  llvm::RecursivelyDeleteTriviallyDeadInstructionsPermissive(dead);
+}
+
+llvm::ConstantRange RangeAnalysis::GetRange(const llvm::Value& value) const {
+  const auto width = value.getType()->getIntegerBitWidth();
+  if (const auto* const constant = llvm::dyn_cast<llvm::ConstantInt>(&value)) {
+    return llvm::ConstantRange{constant->getValue()};
+  }
+  if (const auto it = ranges_.find(&value); it != ranges_.end()) {
+    return it->second;
+  }
+  // An instruction not reached yet has no values so far; arguments, and
+  // whatever else, may have any.
+  return llvm::isa<llvm::Instruction>(value)
+             ? llvm::ConstantRange::getEmpty(width)
+             : llvm::ConstantRange::getFull(width);
+}
+
+llvm::ConstantRange RangeAnalysis::GetRangeOnEdge(
+    const llvm::Value& value, const llvm::BasicBlock* const from,
+    const llvm::BasicBlock* const to) {
+  if (from == nullptr || !tested_.contains(&value)) {
+    return GetRange(value);
+  }
+  return Narrow(GetRangeAtEnd(value, *from), value, *from, *to);
+}
+
+llvm::ConstantRange RangeAnalysis::GetRangeAtEnd(
+    const llvm::Value& value, const llvm::BasicBlock& block) {
+  const auto* const inst = llvm::dyn_cast<llvm::Instruction>(&value);
+  const auto* const definition = inst != nullptr ? inst->getParent() : nullptr;
+
+  // Up to a block whose range is known, or where the chain ends: branches
+  // before the definition can't have tested the value.
+  auto chain = llvm::SmallVector<const llvm::BasicBlock*, 8>{};
+  auto range = GetRange(value);
+  const auto* top = &block;
+  for (;;) {
+    if (const auto it = ends_.find({&value, top}); it != ends_.end()) {
+      range = it->second;
+      break;
+    }
+    const auto* const pred = top->getSinglePredecessor();
+    if (top == definition || pred == nullptr) {
+      ends_.try_emplace({&value, top}, range);
+      break;
+    }
+    chain.push_back(top);
+    top = pred;
+  }
+
+  // And back down, narrowing on every edge.
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    range = Narrow(std::move(range), value, *top, **it);
+    ends_.try_emplace({&value, *it}, range);
+    top = *it;
+  }
+  return range;
+}
+
+llvm::ConstantRange RangeAnalysis::GetOperandRange(
+    const llvm::Instruction& user, const unsigned index) {
+  const auto& operand = *user.getOperand(index);
+  if (const auto* const phi = llvm::dyn_cast<llvm::PHINode>(&user)) {
+    return GetRangeOnEdge(operand, phi->getIncomingBlock(index),
+                          phi->getParent());
+  }
+  // An operand defined in the same block isn't tested on the way in.
+  const auto* const inst = llvm::dyn_cast<llvm::Instruction>(&operand);
+  if (inst != nullptr && inst->getParent() == user.getParent()) {
+    return GetRange(operand);
+  }
+  return GetRangeOnEdge(operand, user.getParent()->getSinglePredecessor(),
+                        user.getParent());
+}
+
+llvm::ConstantRange RangeAnalysis::Narrow(llvm::ConstantRange range,
+                                          const llvm::Value& value,
+                                          const llvm::BasicBlock& from,
+                                          const llvm::BasicBlock& to) const {
+  const auto* const branch =
+      llvm::dyn_cast<llvm::BranchInst>(from.getTerminator());
+  if (branch == nullptr || !branch->isConditional() ||
+      branch->getSuccessor(0) == branch->getSuccessor(1)) {
+    return range;
+  }
+  return Constrain(std::move(range), value, *branch->getCondition(),
+                   branch->getSuccessor(0) == &to, 0);
+}
+
+llvm::ConstantRange RangeAnalysis::Constrain(llvm::ConstantRange range,
+                                             const llvm::Value& value,
+                                             const llvm::Value& condition,
+                                             const bool holds,
+                                             const int depth) const {
+  if (depth > kMaxConditionDepth) {
+    return range;
+  }
+
+  if (const auto* const compare = llvm::dyn_cast<llvm::ICmpInst>(&condition)) {
+    const auto& lhs = *compare->getOperand(0);
+    const auto& rhs = *compare->getOperand(1);
+    if (lhs.getType() != value.getType()) {
+      return range;
+    }
+    const auto predicate =
+        holds ? compare->getPredicate() : compare->getInversePredicate();
+    if (&lhs == &value) {
+      range = range.intersectWith(
+          llvm::ConstantRange::makeAllowedICmpRegion(predicate, GetRange(rhs)),
+          llvm::ConstantRange::Signed);
+    }
+    if (&rhs == &value) {
+      range = range.intersectWith(
+          llvm::ConstantRange::makeAllowedICmpRegion(
+              llvm::CmpInst::getSwappedPredicate(predicate), GetRange(lhs)),
+          llvm::ConstantRange::Signed);
+    }
+    return range;
+  }
+
+  const auto* const binary = llvm::dyn_cast<llvm::BinaryOperator>(&condition);
+  if (binary == nullptr) {
+    return range;
+  }
+  const auto opcode = binary->getOpcode();
+  // Both operands of an eager && hold if it does, and neither of an ||
+  // holds if it doesn't.
+  if ((opcode == llvm::Instruction::And && holds) ||
+      (opcode == llvm::Instruction::Or && !holds)) {
+    range = Constrain(std::move(range), value, *binary->getOperand(0), holds,
+                      depth + 1);
+    return Constrain(std::move(range), value, *binary->getOperand(1), holds,
+                     depth + 1);
+  }
+  const auto* const mask =
+      llvm::dyn_cast<llvm::ConstantInt>(binary->getOperand(1));
+  if (opcode == llvm::Instruction::Xor && mask != nullptr && mask->isOne() &&
+      binary->getType()->isIntegerTy(1)) {
+    return Constrain(std::move(range), value, *binary->getOperand(0), !holds,
+                     depth + 1);
+  }
+  return range;
+}
+
+void RangeAnalysis::AddTested(const llvm::Value& condition,
+                              const int depth) {
+  if (depth > kMaxConditionDepth) {
+    return;
+  }
+  if (const auto* const compare = llvm::dyn_cast<llvm::ICmpInst>(&condition)) {
+    for (const auto& operand : compare->operands()) {
+      if (!llvm::isa<llvm::Constant>(operand)) {
+        tested_.insert(operand);
+      }
+    }
+    return;
+  }
+  if (const auto* const binary =
+          llvm::dyn_cast<llvm::BinaryOperator>(&condition)) {
+    for (const auto& operand : binary->operands()) {
+      AddTested(*operand, depth + 1);
+    }
+  }
+}
+
+llvm::ConstantRange RangeAnalysis::Compute(const llvm::Instruction& inst) {
+  const auto width = inst.getType()->getIntegerBitWidth();
+  if (const auto* const phi = llvm::dyn_cast<llvm::PHINode>(&inst)) {
+    auto range = llvm::ConstantRange::getEmpty(width);
+    for (auto i = 0u; i < phi->getNumIncomingValues(); ++i) {
+      range = range.unionWith(GetOperandRange(*phi, i),
+                              llvm::ConstantRange::Signed);
+    }
+    return range;
+  }
+  if (const auto* const binary = llvm::dyn_cast<llvm::BinaryOperator>(&inst)) {
+    return GetOperandRange(inst, 0).binaryOp(binary->getOpcode(),
+                                             GetOperandRange(inst, 1));
+  }
+  if (const auto* const compare = llvm::dyn_cast<llvm::ICmpInst>(&inst)) {
+    if (GetOperandRange(inst, 0).isEmptySet() ||
+        GetOperandRange(inst, 1).isEmptySet()) {
+      return llvm::ConstantRange::getEmpty(1);
+    }
+    const auto holds = Decide(*compare);
+    return holds ? llvm::ConstantRange{llvm::APInt{1, *holds ? 1u : 0u}}
+                 : llvm::ConstantRange::getFull(1);
+  }
+  if (const auto* const cast = llvm::dyn_cast<llvm::CastInst>(&inst)) {
+    return GetOperandRange(inst, 0).castOp(cast->getOpcode(), width);
+  }
+  if (llvm::isa<llvm::SelectInst>(inst)) {
+    const auto condition = GetOperandRange(inst, 0);
+    if (condition.isEmptySet()) {
+      return llvm::ConstantRange::getEmpty(width);
+    }
+    if (const auto* const single = condition.getSingleElement()) {
+      return GetOperandRange(inst, single->isOne() ? 1 : 2);
+    }
+    return GetOperandRange(inst, 1).unionWith(GetOperandRange(inst, 2),
+                                              llvm::ConstantRange::Signed);
+  }
+  return llvm::ConstantRange::getFull(width);
+}
+
+llvm::ConstantRange RangeAnalysis::Widen(
+    const llvm::ConstantRange& old_range, const llvm::ConstantRange& new_range,
+    const bool has_thresholds) const {
+  if (old_range.isEmptySet() || new_range == old_range) {
+    return new_range;
+  }
+
+  const auto width = new_range.getBitWidth();
+  const auto is_thresholded = has_thresholds && width == 64;
+  auto lower = new_range.getSignedMin();
+  auto upper = new_range.getSignedMax();
+  if (lower.slt(old_range.getSignedMin())) {
+    // The greatest threshold at or below the new bound.
+    lower = is_thresholded
+                ? *std::prev(std::upper_bound(thresholds_.begin(),
+                                              thresholds_.end(), lower,
+                                              IsSignedLess))
+                : llvm::APInt::getSignedMinValue(width);
+  }
+  if (upper.sgt(old_range.getSignedMax())) {
+    // The least threshold at or above the new bound.
+    upper = is_thresholded
+                ? *std::lower_bound(thresholds_.begin(), thresholds_.end(),
+                                    upper, IsSignedLess)
+                : llvm::APInt::getSignedMaxValue(width);
+  }
+  return llvm::ConstantRange::getNonEmpty(std::move(lower),
+                                          std::move(upper) + 1);
+}
+
+std::optional<bool> RangeAnalysis::Decide(const llvm::ICmpInst& compare) {
+  const auto lhs = GetOperandRange(compare, 0);
+  const auto rhs = GetOperandRange(compare, 1);
+  if (lhs.isEmptySet() || rhs.isEmptySet()) {
+    return std::nullopt;
+  }
+  if (lhs.icmp(compare.getPredicate(), rhs)) {
+    return true;
+  }
+  if (lhs.icmp(compare.getInversePredicate(), rhs)) {
+    return false;
+  }
+  return std::nullopt;
+}
+
+bool RangeAnalysis::IsNoSignedWrap(const llvm::BinaryOperator& binary) {
+  const auto lhs = GetOperandRange(binary, 0);
+  const auto rhs = GetOperandRange(binary, 1);
+  if (lhs.isEmptySet() || rhs.isEmptySet()) {
+    return false;
+  }
+
+  switch (binary.getOpcode()) {
+    case llvm::Instruction::Add: {
+      return lhs.signedAddMayOverflow(rhs) ==
+             llvm::ConstantRange::OverflowResult::NeverOverflows;
+    }
+    case llvm::Instruction::Sub: {
+      return lhs.signedSubMayOverflow(rhs) ==
+             llvm::ConstantRange::OverflowResult::NeverOverflows;
+    }
+    default: {
+      // A product over two ranges is at its extremes at their bounds.
+      for (const auto& x : {lhs.getSignedMin(), lhs.getSignedMax()}) {
+        for (const auto& y : {rhs.getSignedMin(), rhs.getSignedMax()}) {
+          auto is_overflow = false;
+          static_cast<void>(x.smul_ov(y, is_overflow));
+          if (is_overflow) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+  }
+}
+
+bool RangeAnalysis::IsExact(const llvm::BinaryOperator& division) const {
+  // Ranges don't tell multiples apart, so this takes the known trailing
+  // zeros of the dividend for a divisor that's a power of two.
+  const auto* const divisor =
+      llvm::dyn_cast<llvm::ConstantInt>(division.getOperand(1));
+  if (divisor == nullptr || !divisor->getValue().isStrictlyPositive() ||
+      !divisor->getValue().isPowerOf2()) {
+    return false;
+  }
+  const auto known = llvm::computeKnownBits(
+      division.getOperand(0), function_.getParent()->getDataLayout());
+  return known.countMinTrailingZeros() >= divisor->getValue().logBase2();
+}
+
+}  // namespace
+
+void PropagateRanges(llvm::Function& function) {
+  // Branches on constants, such as the guards of loops that are entered at
+  // least once, are folded first, so the blocks they no longer reach aren't
+  // joined with the values from there.
+  auto is_folded = false;
+  for (auto& block : function) {
+    is_folded |= llvm::ConstantFoldTerminator(&block);
+  }
+  if (is_folded) {
+    llvm::removeUnreachableBlocks(function);
+  }
+
+  auto analysis = RangeAnalysis{function};
+  if (analysis.Run()) {
+    analysis.Apply();
+  }
+}
+
+}  // namespace frontend
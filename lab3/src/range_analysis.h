@@ -0,0 +1,19 @@
+#pragma once
+
+namespace llvm {
+class Function;
+}  // namespace llvm
+
+namespace frontend {
+
+// Value-range analysis over a function as it's been lowered, in SSA form.
+// Every integer value is bounded by a signed range: through arithmetic,
+// narrowed on the edges of branches on comparisons, and joined at phis, where
+// loop counters are widened towards the constants they're compared with.
+// With the ranges, add, sub, and mul that can't overflow get nsw, sdiv of a
+// multiple of a power of two by it gets exact, and comparisons whose outcome
+// is known are folded, which removes the division and bounds checks that
+// can't fail along with the blocks only they reached.
+void PropagateRanges(llvm::Function& function);
+
+}  // namespace frontend
@@ -0,0 +1,328 @@
+#include "resolver.h"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace frontend {
+
+void Resolver::Visit(Program& program) {
+  BeginProgram();
+  for (auto* const stmt : program.get_stmts()) {
+    if (!ResolveStmt(*stmt)) {
+      break;
+    }
+  }
+  for (auto* const def : program.get_functions()) {
+    def->Accept(*this);
+  }
+  EndProgram();
+}
+
+void Resolver::Visit(FunctionDef& def) {
+  const auto symbol = def.get_symbol();
+  const auto name = std::string{symbols_.get_name(symbol)};
+  // main is the entry point the module defines itself.
+  if (name == "main") {
+    throw std::runtime_error("Function main can't be defined");
+  }
+  auto& function =
+      FindFunction(symbol, def.get_params().size(), /*is_definition=*/true);
+  function.is_defined = true;
+  def.set_index(function.index);
+
+  // The body is resolved in scopes of its own, so main's variables aren't
+  // visible, and main continues where it left off afterwards.
+  auto outer_scopes = std::exchange(scopes_, ScopeTable{});
+  const auto outer_slot_count = std::exchange(slot_count_, 0);
+  auto outer_array_lengths = std::exchange(array_lengths_, {});
+  const auto outer_is_terminated = std::exchange(is_terminated_, false);
+
+  scopes_.EnterScope();
+  for (const auto param : def.get_params()) {
+    if (scopes_.Find(param) != kUnresolvedSlot) {
+      throw std::runtime_error("Duplicate parameter " +
+                               std::string{symbols_.get_name(param)} +
+                               " of function " + name);
+    }
+    Declare(param);
+  }
+  VisitBlock(def.get_stmts());
+  if (!is_terminated_) {
+    throw std::runtime_error("Reachable control-flow path of function " +
+                             name + " falls through without return");
+  }
+  def.set_slot_count(slot_count_);
+
+  scopes_ = std::move(outer_scopes);
+  slot_count_ = outer_slot_count;
+  array_lengths_ = std::move(outer_array_lengths);
+  is_terminated_ = outer_is_terminated;
+}
+
+void Resolver::Visit(AssignStmt& stmt) {
+  ResolveExpr(stmt.get_expr());
+
+  const auto symbol = stmt.get_symbol();
+  if (const auto slot = scopes_.Find(symbol); slot != kUnresolvedSlot) {
+    if (array_lengths_[slot] != 0) {
+      throw std::runtime_error("Array " +
+                               std::string{symbols_.get_name(symbol)} +
+                               " can't be assigned to");
+    }
+    stmt.set_slot(slot);
+    return;
+  }
+
+  stmt.set_slot(Declare(symbol));
+}
+
+void Resolver::Visit(StoreStmt& stmt) {
+  ResolveExpr(stmt.get_index());
+  ResolveExpr(stmt.get_expr());
+
+  const auto slot = FindArray(stmt.get_symbol());
+  stmt.set_slot(slot);
+  stmt.set_length(array_lengths_[slot]);
+}
+
+void Resolver::Visit(ArrayDeclStmt& stmt) {
+  const auto length = stmt.get_length();
+  if (length < 1 || length > ArrayDeclStmt::kMaxLength) {
+    throw std::runtime_error(
+        "Array " + std::string{symbols_.get_name(stmt.get_symbol())} +
+        " must have 1 to " + std::to_string(ArrayDeclStmt::kMaxLength) +
+        " elements");
+  }
+  stmt.set_slot(Declare(stmt.get_symbol(), length));
+}
+
+void Resolver::Visit(IfStmt& stmt) {
+  ResolveExpr(stmt.get_cond());
+
+  VisitBlock(stmt.get_then_stmts());
+  const auto is_then_terminated = is_terminated_;
+
+  VisitBlock(stmt.get_else_stmts());
+  is_terminated_ = is_then_terminated && is_terminated_;
+}
+
+void Resolver::Visit(WhileStmt& stmt) {
+  ResolveExpr(stmt.get_cond());
+
+  VisitBlock(stmt.get_stmts());
+  is_terminated_ = false;
+}
+
+void Resolver::Visit(ReturnStmt& stmt) {
+  ResolveExpr(stmt.get_expr());
+  is_terminated_ = true;
+}
+
+void Resolver::Visit(BinaryExpr& expr) { ResolveExpr(expr); }
+
+void Resolver::Visit(UnaryExpr& expr) { ResolveExpr(expr); }
+
+void Resolver::Visit(VarExpr& expr) { ResolveVar(expr); }
+
+void Resolver::Visit([[maybe_unused]] NumberExpr& expr) {}
+
+void Resolver::Visit(CallExpr& expr) { ResolveExpr(expr); }
+
+void Resolver::Visit(IndexExpr& expr) { ResolveExpr(expr); }
+
+void Resolver::Visit(LengthExpr& expr) { ResolveLeaf(expr); }
+
+void Resolver::BeginProgram() {
+  scopes_.EnterScope();
+  is_terminated_ = false;
+}
+
+bool Resolver::ResolveStmt(IStmt& stmt) {
+  if (is_terminated_) {
+    return false;
+  }
+  stmt.Accept(*this);
+  return true;
+}
+
+void Resolver::EndProgram() {
+  scopes_.LeaveScope();
+
+  // Checked before constant folding can remove paths, so that the programs
+  // accepted don't depend on which conditions are constant.
+  if (!is_terminated_) {
+    throw std::runtime_error(
+        "Reachable control-flow path falls through without return");
+  }
+
+  for (const auto symbol : function_symbols_) {
+    if (!functions_[symbol].is_defined) {
+      throw std::runtime_error("Unknown function " +
+                               std::string{symbols_.get_name(symbol)});
+    }
+  }
+}
+
+void Resolver::ResolveExpr(IExpr& expr) {
+  if (ResolveLeaf(expr)) {
+    return;
+  }
+
+  // Leaves are resolved on the spot and other operands are pushed right to
+  // left, so unknown names are reported in source order.
+  pending_exprs_.clear();
+  pending_exprs_.push_back(&expr);
+  while (!pending_exprs_.empty()) {
+    auto* const pending = pending_exprs_.back();
+    pending_exprs_.pop_back();
+    switch (pending->get_kind()) {
+      case NodeKind::kBinaryExpr: {
+        auto* const binary = llvm::cast<BinaryExpr>(pending);
+        if (!ResolveLeaf(binary->get_lhs())) {
+          pending_exprs_.push_back(&binary->get_rhs());
+          pending_exprs_.push_back(&binary->get_lhs());
+        } else if (!ResolveLeaf(binary->get_rhs())) {
+          pending_exprs_.push_back(&binary->get_rhs());
+        }
+        break;
+      }
+      case NodeKind::kUnaryExpr: {
+        auto& operand = llvm::cast<UnaryExpr>(pending)->get_expr();
+        if (!ResolveLeaf(operand)) {
+          pending_exprs_.push_back(&operand);
+        }
+        break;
+      }
+      case NodeKind::kCallExpr: {
+        auto* const call = llvm::cast<CallExpr>(pending);
+        const auto args = call->get_args();
+        call->set_function(
+            FindFunction(call->get_symbol(), args.size(),
+                         /*is_definition=*/false)
+                .index);
+        for (auto it = args.rbegin(); it != args.rend(); ++it) {
+          pending_exprs_.push_back(*it);
+        }
+        break;
+      }
+      case NodeKind::kIndexExpr: {
+        auto* const index = llvm::cast<IndexExpr>(pending);
+        const auto slot = FindArray(index->get_symbol());
+        index->set_slot(slot);
+        index->set_length(array_lengths_[slot]);
+        if (!ResolveLeaf(index->get_index())) {
+          pending_exprs_.push_back(&index->get_index());
+        }
+        break;
+      }
+      default: {
+        ResolveLeaf(*pending);
+        break;
+      }
+    }
+  }
+}
+
+bool Resolver::ResolveLeaf(IExpr& expr) {
+  switch (expr.get_kind()) {
+    case NodeKind::kVarExpr: {
+      ResolveVar(llvm::cast<VarExpr>(expr));
+      return true;
+    }
+    case NodeKind::kNumberExpr: {
+      return true;
+    }
+    case NodeKind::kLengthExpr: {
+      auto& length = llvm::cast<LengthExpr>(expr);
+      length.set_length(array_lengths_[FindArray(length.get_symbol())]);
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+void Resolver::ResolveVar(VarExpr& expr) {
+  const auto symbol = expr.get_symbol();
+  const auto slot = scopes_.Find(symbol);
+  if (slot == kUnresolvedSlot) {
+    throw std::runtime_error("Unknown variable " +
+                             std::string{symbols_.get_name(symbol)});
+  }
+  if (array_lengths_[slot] != 0) {
+    throw std::runtime_error("Array " +
+                             std::string{symbols_.get_name(symbol)} +
+                             " can't be used as a number");
+  }
+
+  expr.set_slot(slot);
+}
+
+Slot Resolver::Declare(const Symbol symbol, const std::int64_t length) {
+  scopes_.Declare(symbol, slot_count_);
+  array_lengths_.push_back(length);
+  return slot_count_++;
+}
+
+Slot Resolver::FindArray(const Symbol symbol) const {
+  const auto slot = scopes_.Find(symbol);
+  if (slot == kUnresolvedSlot) {
+    throw std::runtime_error("Unknown variable " +
+                             std::string{symbols_.get_name(symbol)});
+  }
+  if (array_lengths_[slot] == 0) {
+    throw std::runtime_error("Variable " +
+                             std::string{symbols_.get_name(symbol)} +
+                             " isn't an array");
+  }
+  return slot;
+}
+
+Resolver::Function& Resolver::FindFunction(const Symbol symbol,
+                                           const std::size_t arity,
+                                           const bool is_definition) {
+  if (symbol >= functions_.size()) {
+    functions_.resize(symbol + 1);
+  }
+  auto& function = functions_[symbol];
+  const auto name = [&] { return std::string{symbols_.get_name(symbol)}; };
+  if (is_definition && function.is_defined) {
+    throw std::runtime_error("Redefinition of function " + name());
+  }
+  if (function.index == kUnresolvedFunction) {
+    function.index = get_function_count();
+    function.arity = arity;
+    function_symbols_.push_back(symbol);
+  } else if (function.arity != arity) {
+    // Calls may come before the definition, so the arity seen first isn't
+    // necessarily the one the function takes.
+    if (!function.is_defined && !is_definition) {
+      throw std::runtime_error("Function " + name() + " is called with " +
+                               std::to_string(function.arity) + " and " +
+                               std::to_string(arity) + " arguments");
+    }
+    const auto [takes, given] = function.is_defined
+                                    ? std::pair{function.arity, arity}
+                                    : std::pair{arity, function.arity};
+    throw std::runtime_error("Function " + name() + " takes " +
+                             std::to_string(takes) + " arguments, not " +
+                             std::to_string(given));
+  }
+  return function;
+}
+
+void Resolver::VisitBlock(const StmtList stmts) {
+  scopes_.EnterScope();
+  is_terminated_ = false;
+  for (auto* const stmt : stmts) {
+    if (is_terminated_) {
+      break;
+    }
+    stmt->Accept(*this);
+  }
+  scopes_.LeaveScope();
+}
+
+}  // namespace frontend
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "node.h"
+#include "scope_table.h"
+#include "symbol_table.h"
+#include "visitor.h"
+
+namespace frontend {
+
+// Binds every variable reference to a numeric slot before code generation,
+// following the lexical scoping rules: assigning a name that isn't visible
+// declares a new variable in the innermost scope, and so does an array
+// declaration, which may shadow a visible name. Reading an unknown name is an
+// error, and so are an array used as a number or a number indexed as an
+// array, and a path that reaches the end of the program or of a function
+// without a return. Like the code generator, statements after a
+// terminator are skipped. Functions see only their parameters and their own
+// variables, which are numbered from zero in every function, and may be
+// called before they're defined; calls are checked against the number of
+// parameters. Expressions are walked with an explicit stack rather than by
+// recursion, so operator chains of any length resolve in constant stack
+// space.
+class Resolver final : public IVisitor {
+ public:
+  explicit Resolver(const SymbolTable& symbols) noexcept : symbols_(symbols) {}
+
+  void Visit(Program& program) override;
+  void Visit(FunctionDef& def) override;
+  void Visit(AssignStmt& stmt) override;
+  void Visit(StoreStmt& stmt) override;
+  void Visit(ArrayDeclStmt& stmt) override;
+  void Visit(IfStmt& stmt) override;
+  void Visit(WhileStmt& stmt) override;
+  void Visit(ReturnStmt& stmt) override;
+  void Visit(BinaryExpr& expr) override;
+  void Visit(UnaryExpr& expr) override;
+  void Visit(VarExpr& expr) override;
+  void Visit(NumberExpr& expr) override;
+  void Visit(CallExpr& expr) override;
+  void Visit(IndexExpr& expr) override;
+  void Visit(LengthExpr& expr) override;
+
+  // Resolves a program one top-level statement or function at a time, as the
+  // parser streams them. ResolveStmt returns false for statements after a
+  // return, which are skipped, and EndProgram rejects a program that falls
+  // through or calls a function that is never defined.
+  void BeginProgram();
+  bool ResolveStmt(IStmt& stmt);
+  void EndProgram();
+
+  // The slots used by main.
+  Slot get_slot_count() const noexcept { return slot_count_; }
+  FunctionIndex get_function_count() const noexcept {
+    return static_cast<FunctionIndex>(function_symbols_.size());
+  }
+
+ private:
+  struct Function final {
+    FunctionIndex index = kUnresolvedFunction;
+    std::size_t arity = 0;
+    bool is_defined = false;
+  };
+
+  void VisitBlock(StmtList stmts);
+  void ResolveExpr(IExpr& expr);
+  // Resolves a variable, number, or length; returns false for operators.
+  bool ResolveLeaf(IExpr& expr);
+  void ResolveVar(VarExpr& expr);
+  // Declares the symbol in the innermost scope, as an array if the length
+  // isn't zero, and returns its slot.
+  Slot Declare(Symbol symbol, std::int64_t length = 0);
+  // Returns the slot of the visible array with the symbol.
+  Slot FindArray(Symbol symbol) const;
+  // Returns the function with the symbol, numbering it on its first
+  // mention, and checks that every mention agrees on its arity.
+  Function& FindFunction(Symbol symbol, std::size_t arity, bool is_definition);
+
+ private:
+  const SymbolTable& symbols_;
+  // Operands still to be resolved, reused across expressions.
+  std::vector<IExpr*> pending_exprs_;
+  ScopeTable scopes_;
+  Slot slot_count_ = 0;
+  // The length of the array in every slot, or zero for numbers.
+  std::vector<std::int64_t> array_lengths_;
+  // Indexed by symbol, like the scopes.
+  std::vector<Function> functions_;
+  // Indexed by function.
+  std::vector<Symbol> function_symbols_;
+  bool is_terminated_ = false;
+};
+
+}  // namespace frontend
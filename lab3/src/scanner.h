@@ -1,7 +1,8 @@
 #pragma once
 
-#include <iostream>
-#include <ostream>
+#include <cstddef>
+#include <string>
+#include <string_view>
 
 #ifndef yyFlexLexer
 #include <FlexLexer.h>
@@ -17,16 +18,27 @@ namespace frontend {
 
 class Scanner final : public yyFlexLexer {
  public:
-  Scanner(std::istream& is = std::cin, std::ostream& os = std::cout,
+  // Scans source in place; it must outlive the scanner, and identifiers are
+  // interned as views into it.
+  Scanner(SymbolTable& symbols, std::string_view source,
           const std::string* isname = nullptr);
 
   Parser::symbol_type Get();
 
+ protected:
+  int LexerInput(char* buf, int max_size) override;
+
  private:
-  Parser::symbol_type MakeNumber(const std::string& str,
+  std::string_view Text() const noexcept;
+  Parser::symbol_type MakeNumber(std::string_view str,
                                  const Parser::location_type& loc);
 
  private:
+  SymbolTable& symbols_;
+  std::string_view source_;
+  // Offsets of the next byte handed to Flex and of the end of the last token.
+  std::size_t input_offset_ = 0;
+  std::size_t token_end_ = 0;
   location loc_;
 };
 
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "symbol_table.h"
+
+namespace frontend {
+
+// Flat lexically scoped map from symbols to slots. The current binding of
+// every symbol lives in one array indexed by the symbol, so a lookup is a
+// single load regardless of nesting depth. Declarations record the binding
+// they replace in an undo log, and leaving a scope rolls the log back to the
+// marker pushed when the scope was entered.
+class ScopeTable final {
+ public:
+  void EnterScope() { markers_.push_back(undo_log_.size()); }
+
+  void LeaveScope() {
+    const auto marker = markers_.back();
+    markers_.pop_back();
+    while (undo_log_.size() > marker) {
+      const auto [symbol, previous] = undo_log_.back();
+      undo_log_.pop_back();
+      bindings_[symbol] = previous;
+    }
+  }
+
+  void Declare(const Symbol symbol, const Slot slot) {
+    if (symbol >= bindings_.size()) {
+      bindings_.resize(symbol + 1, kUnresolvedSlot);
+    }
+    undo_log_.emplace_back(symbol, bindings_[symbol]);
+    bindings_[symbol] = slot;
+  }
+
+  // Returns kUnresolvedSlot if the symbol isn't visible.
+  Slot Find(const Symbol symbol) const noexcept {
+    return symbol < bindings_.size() ? bindings_[symbol] : kUnresolvedSlot;
+  }
+
+ private:
+  std::vector<Slot> bindings_;
+  std::vector<std::pair<Symbol, Slot>> undo_log_;
+  std::vector<std::size_t> markers_;
+};
+
+}  // namespace frontend
@@ -0,0 +1,360 @@
+#include "server.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bytecode_compiler.h"
+#include "compiler.h"
+#include "driver.h"
+#include "interpreter.h"
+#include "paraparacl.h"
+#include "session.h"
+
+namespace frontend {
+
+namespace {
+
+constexpr std::size_t kMaxHeaderSize = 256;
+constexpr std::size_t kMaxSourceSize = std::size_t{1} << 30;
+constexpr std::size_t kBufferSize = 64 * 1024;
+// The loop iterations and calls of a run request, some seconds' worth.
+constexpr std::uint64_t kMaxRunJumps = std::uint64_t{1} << 30;
+
+struct Request final {
+  std::string id;
+  std::string kind;
+  std::string source;
+};
+
+std::system_error MakeSystemError(const char* what) {
+  return std::system_error{errno, std::generic_category(), what};
+}
+
+class FileDescriptor final {
+ public:
+  explicit FileDescriptor(const int fd) noexcept : fd_(fd) {}
+  FileDescriptor(FileDescriptor&& other) noexcept
+      : fd_(std::exchange(other.fd_, -1)) {}
+  FileDescriptor& operator=(FileDescriptor&&) = delete;
+  ~FileDescriptor() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  int get() const noexcept { return fd_; }
+
+ private:
+  int fd_;
+};
+
+// The two byte streams of one client. Reads and writes are serialized
+// separately, so several workers can serve one connection.
+class Connection final {
+ public:
+  Connection(int input, int output);
+
+  // Reads the next request. Returns false at the end of the input, or after
+  // answering a malformed request.
+  bool Read(Request& request);
+  void Write(std::string_view id, std::string_view status,
+             std::string_view payload);
+
+ private:
+  // Reads a line into the header. Returns false if the input ends first, or
+  // if the line grows longer than a header may be.
+  bool ReadHeader(std::string& header);
+  bool Reject(std::string_view message);
+  // Refills the empty buffer; returns false at the end of the input.
+  bool Fill();
+
+  int input_;
+  int output_;
+  std::mutex read_mutex_;
+  std::mutex write_mutex_;
+  bool is_closed_ = false;
+  std::vector<char> buffer_;
+  std::size_t begin_ = 0;
+  std::size_t end_ = 0;
+};
+
+Connection::Connection(const int input, const int output)
+    : input_(input), output_(output), buffer_(kBufferSize) {}
+
+bool Connection::Read(Request& request) {
+  const auto lock = std::scoped_lock{read_mutex_};
+  if (is_closed_) {
+    return false;
+  }
+
+  auto header = std::string{};
+  const auto is_complete = ReadHeader(header);
+  if (header.size() > kMaxHeaderSize) {
+    is_closed_ = true;
+    return Reject("Request header is too long");
+  }
+  if (!is_complete) {
+    is_closed_ = true;
+    return header.empty() ? false : Reject("Truncated request header");
+  }
+
+  auto fields = std::istringstream{header};
+  auto size_field = std::string{};
+  auto rest = std::string{};
+  if (!(fields >> request.id >> request.kind >> size_field) ||
+      (fields >> rest)) {
+    is_closed_ = true;
+    return Reject("Malformed request header");
+  }
+  auto size = std::size_t{0};
+  const auto* const size_end = size_field.data() + size_field.size();
+  const auto [ptr, error] =
+      std::from_chars(size_field.data(), size_end, size);
+  if (error != std::errc{} || ptr != size_end) {
+    is_closed_ = true;
+    return Reject("Malformed request size");
+  }
+  if (size > kMaxSourceSize) {
+    is_closed_ = true;
+    return Reject("Request is too large");
+  }
+
+  request.source.resize(size);
+  for (auto copied = std::size_t{0}; copied < size;) {
+    if (begin_ == end_ && !Fill()) {
+      is_closed_ = true;
+      return Reject("Truncated request");
+    }
+    const auto count = std::min(size - copied, end_ - begin_);
+    std::memcpy(request.source.data() + copied, buffer_.data() + begin_,
+                count);
+    begin_ += count;
+    copied += count;
+  }
+  return true;
+}
+
+bool Connection::ReadHeader(std::string& header) {
+  while (header.size() <= kMaxHeaderSize) {
+    if (begin_ == end_ && !Fill()) {
+      return false;
+    }
+    const auto* const first = buffer_.data() + begin_;
+    const auto* const last = buffer_.data() + end_;
+    const auto* const newline = std::find(first, last, '\n');
+    header.append(first, newline);
+    begin_ = static_cast<std::size_t>(newline - buffer_.data());
+    if (newline != last) {
+      ++begin_;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Connection::Reject(const std::string_view message) {
+  Write("-", "error", message);
+  return false;
+}
+
+bool Connection::Fill() {
+  begin_ = 0;
+  end_ = 0;
+  while (true) {
+    const auto count = read(input_, buffer_.data(), buffer_.size());
+    if (count >= 0) {
+      end_ = static_cast<std::size_t>(count);
+      return count > 0;
+    }
+    if (errno != EINTR) {
+      throw MakeSystemError("Failed to read a request");
+    }
+  }
+}
+
+void Connection::Write(const std::string_view id,
+                       const std::string_view status,
+                       const std::string_view payload) {
+  auto response = std::string{id};
+  response += ' ';
+  response += status;
+  response += ' ';
+  response += std::to_string(payload.size());
+  response += '\n';
+  response += payload;
+
+  const auto lock = std::scoped_lock{write_mutex_};
+  for (auto written = std::size_t{0}; written < response.size();) {
+    const auto count = write(output_, response.data() + written,
+                             response.size() - written);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw MakeSystemError("Failed to write a response");
+    }
+    written += static_cast<std::size_t>(count);
+  }
+}
+
+// Interprets the program instead of running it through the JIT, so that a
+// division by zero or an index out of bounds becomes an error in the
+// response rather than a trap that kills the server, and a program that
+// doesn't end is stopped.
+std::string RunRequest(const Options& options, const Request& request) {
+  // Locations in syntax errors name the request.
+  auto driver = Driver{};
+  driver.ParseBuffer(request.source, request.id);
+  auto compiler = BytecodeCompiler{Analyze(driver), options.codegen};
+  driver.get_program()->Accept(compiler);
+  return std::to_string(Interpret(compiler.TakeBytecode(), kMaxRunJumps));
+}
+
+std::string CompileRequest(const Options& options, Session& session,
+                           const Request& request) {
+  if (request.kind == "run") {
+    return RunRequest(options, request);
+  }
+  const auto kind = ParseEmitKind(request.kind);
+  if (!kind) {
+    throw std::runtime_error("Unknown request kind " + request.kind);
+  }
+
+  auto result = CompileSource(session, request.source,
+                              SourceOptions{.name = request.id,
+                                            .pipeline = options.pipeline,
+                                            .codegen = options.codegen,
+                                            .emit_kind = kind});
+  if (!result.diagnostics.empty()) {
+    throw std::runtime_error(Format(result.diagnostics.front(), request.id));
+  }
+  return std::move(result.output);
+}
+
+// Answers requests until the connection ends or fails. Failing to compile a
+// program is answered with an error and doesn't end the connection.
+void ServeConnection(Connection& connection, const Options& options,
+                     Session& session) {
+  try {
+    auto request = Request{};
+    while (connection.Read(request)) {
+      auto output = std::string{};
+      try {
+        output = CompileRequest(options, session, request);
+      } catch (const std::exception& e) {
+        connection.Write(request.id, "error", e.what());
+        continue;
+      }
+      connection.Write(request.id, "ok", output);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+FileDescriptor Listen(const std::string& socket_path) {
+  auto address = sockaddr_un{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path is too long: " + socket_path);
+  }
+  std::copy(socket_path.begin(), socket_path.end(), address.sun_path);
+
+  // A socket left behind by an earlier server is replaced; other files
+  // aren't touched and make bind fail.
+  struct stat status = {};
+  if (lstat(socket_path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+    unlink(socket_path.c_str());
+  }
+
+  auto listener =
+      FileDescriptor{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+  if (listener.get() < 0) {
+    throw MakeSystemError("Failed to create a socket");
+  }
+  if (bind(listener.get(), reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) != 0) {
+    throw MakeSystemError(("Failed to bind " + socket_path).c_str());
+  }
+  if (listen(listener.get(), SOMAXCONN) != 0) {
+    throw MakeSystemError(("Failed to listen on " + socket_path).c_str());
+  }
+  return listener;
+}
+
+void AcceptConnections(const int listener, const Options& options,
+                       Session& session) {
+  while (true) {
+    const auto client = accept(listener, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      std::cerr << MakeSystemError("Failed to accept a connection").what()
+                << std::endl;
+      return;
+    }
+    const auto descriptor = FileDescriptor{client};
+    auto connection = Connection{client, client};
+    ServeConnection(connection, options, session);
+  }
+}
+
+}  // namespace
+
+void Serve(const Options& options) {
+  // A client that goes away makes writes fail instead of killing the server.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  // The first session reports an invalid target CPU before any request is
+  // accepted, so the sessions of the other workers can't fail to initialize.
+  auto session = Session{options.target_cpu};
+  const auto jobs = GetJobCount(options);
+
+  if (options.socket_path.empty()) {
+    auto connection = Connection{STDIN_FILENO, STDOUT_FILENO};
+    auto workers = std::vector<std::jthread>{};
+    workers.reserve(jobs - 1);
+    for (auto i = 1U; i < jobs; ++i) {
+      workers.emplace_back([&] {
+        auto worker_session = Session{options.target_cpu};
+        ServeConnection(connection, options, worker_session);
+      });
+    }
+    ServeConnection(connection, options, session);
+    return;
+  }
+
+  const auto listener = Listen(options.socket_path);
+  auto workers = std::vector<std::jthread>{};
+  workers.reserve(jobs - 1);
+  for (auto i = 1U; i < jobs; ++i) {
+    workers.emplace_back([&] {
+      auto worker_session = Session{options.target_cpu};
+      AcceptConnections(listener.get(), options, worker_session);
+    });
+  }
+  AcceptConnections(listener.get(), options, session);
+}
+
+}  // namespace frontend
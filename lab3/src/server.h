@@ -0,0 +1,34 @@
+#pragma once
+
+#include "options.h"
+
+namespace frontend {
+
+// Compiles programs for the clients of one long-lived process, so that
+// process startup and LLVM initialization are paid once. Every worker thread
+// keeps its own session and reuses it for all the programs it compiles; each
+// program is compiled in an LLVM context of its own, so the server doesn't
+// grow with the number of requests.
+//
+// Requests and responses are framed alike, as a header line of three fields
+// followed by a payload of the given number of bytes:
+//
+//   request:  <id> <kind> <size>\n<source>
+//   response: <id> ok <size>\n<output>
+//             <id> error <size>\n<message>
+//
+// The id is chosen by the client and contains no whitespace; with several
+// workers, responses may arrive out of order. The kind is "ll", "bc", "asm"
+// or "obj" to get the module in that form, or "run" to interpret it and get
+// the decimal result of main, so that a program that traps or doesn't end
+// fails its request rather than the server. Optimization and target options
+// are the server's.
+// A malformed request is answered with the id "-" and ends the connection.
+//
+// Without a socket path, requests are read from stdin and responses written
+// to stdout until stdin ends. With one, the server listens on that Unix
+// domain socket until it's killed, and each worker serves one connection at
+// a time.
+void Serve(const Options& options);
+
+}  // namespace frontend
@@ -0,0 +1,167 @@
+#include "session.h"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// clang-format off
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+// clang-format on
+
+#include "llvm_error.h"
+
+namespace frontend {
+
+namespace {
+
+void InitializeNativeTarget() {
+  static const bool is_initialized = [] {
+    return !llvm::InitializeNativeTarget() &&
+           !llvm::InitializeNativeTargetAsmPrinter();
+  }();
+  if (!is_initialized) {
+    throw std::runtime_error("Failed to initialize the native target");
+  }
+}
+
+}  // namespace
+
+class Session::Impl final {
+ public:
+  explicit Impl(std::string_view target_cpu);
+
+  void Configure(llvm::Module& module);
+  llvm::TargetMachine& GetTargetMachine();
+  std::unique_ptr<llvm::TargetMachine> CreateTargetMachine() const;
+  std::int64_t Run(OwnedModule module);
+
+ private:
+  llvm::orc::JITTargetMachineBuilder CreateTargetMachineBuilder() const;
+
+  std::string target_cpu_;
+  std::unique_ptr<llvm::TargetMachine> target_machine_;
+  std::unique_ptr<llvm::orc::LLJIT> jit_;
+};
+
+Session::Impl::Impl(const std::string_view target_cpu)
+    : target_cpu_(target_cpu) {
+  if (!target_cpu_.empty()) {
+    // Reports an unknown CPU before anything is compiled.
+    GetTargetMachine();
+  }
+}
+
+void Session::Impl::Configure(llvm::Module& module) {
+  const auto& target_machine = GetTargetMachine();
+  module.setTargetTriple(target_machine.getTargetTriple().str());
+  module.setDataLayout(target_machine.createDataLayout());
+  if (target_cpu_.empty()) {
+    return;
+  }
+
+  for (auto& function : module) {
+    function.addFnAttr("target-cpu", target_machine.getTargetCPU());
+    function.addFnAttr("target-features",
+                       target_machine.getTargetFeatureString());
+  }
+}
+
+llvm::TargetMachine& Session::Impl::GetTargetMachine() {
+  if (!target_machine_) {
+    target_machine_ = CreateTargetMachine();
+  }
+  return *target_machine_;
+}
+
+std::unique_ptr<llvm::TargetMachine> Session::Impl::CreateTargetMachine()
+    const {
+  return Unwrap(CreateTargetMachineBuilder().createTargetMachine());
+}
+
+std::int64_t Session::Impl::Run(OwnedModule module) {
+  if (!jit_) {
+    jit_ = Unwrap(llvm::orc::LLJITBuilder()
+                      .setJITTargetMachineBuilder(CreateTargetMachineBuilder())
+                      .create());
+    // Clearing an array calls memset, which comes from the C library this
+    // process has loaded.
+    jit_->getMainJITDylib().addGenerator(
+        Unwrap(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+            jit_->getDataLayout().getGlobalPrefix())));
+  }
+
+  // Everything the module adds to the JIT is tracked, so that it can be
+  // removed once main has returned. The JIT takes the module together with a
+  // context it may lock, and frees the context with the module.
+  auto tracker = jit_->getMainJITDylib().createResourceTracker();
+  Check(jit_->addIRModule(
+      tracker, llvm::orc::ThreadSafeModule(
+                   std::move(module.module),
+                   llvm::orc::ThreadSafeContext{std::move(module.context)})));
+
+  auto result = [this]() -> llvm::Expected<std::int64_t> {
+    auto address = jit_->lookup("main");
+    if (!address) {
+      return address.takeError();
+    }
+    return address->toPtr<std::int64_t (*)()>()();
+  }();
+  Check(tracker->remove());
+  return Unwrap(std::move(result));
+}
+
+llvm::orc::JITTargetMachineBuilder
+Session::Impl::CreateTargetMachineBuilder() const {
+  InitializeNativeTarget();
+  auto builder = Unwrap(llvm::orc::JITTargetMachineBuilder::detectHost());
+  if (target_cpu_ != "native") {
+    auto error = std::string{};
+    const auto triple = builder.getTargetTriple().str();
+    const auto* const target =
+        llvm::TargetRegistry::lookupTarget(triple, error);
+    if (target == nullptr) {
+      throw std::runtime_error("Failed to find the host target: " + error);
+    }
+    const auto subtarget = std::unique_ptr<llvm::MCSubtargetInfo>{
+        target->createMCSubtargetInfo(triple, "", "")};
+    if (!target_cpu_.empty() && !subtarget->isCPUStringValid(target_cpu_)) {
+      throw std::runtime_error("Unknown CPU " + target_cpu_ + " for " +
+                               triple);
+    }
+    builder.setCPU(target_cpu_);
+    builder.getFeatures() = llvm::SubtargetFeatures{};
+  }
+  // Objects are linked into position-independent executables by default.
+  builder.setRelocationModel(llvm::Reloc::PIC_);
+  return builder;
+}
+
+Session::Session(const std::string_view target_cpu)
+    : impl_(std::make_unique<Impl>(target_cpu)) {}
+
+Session::~Session() = default;
+
+void Session::Configure(llvm::Module& module) { impl_->Configure(module); }
+
+llvm::TargetMachine& Session::GetTargetMachine() {
+  return impl_->GetTargetMachine();
+}
+
+std::unique_ptr<llvm::TargetMachine> Session::CreateTargetMachine() const {
+  return impl_->CreateTargetMachine();
+}
+
+std::int64_t Session::Run(OwnedModule module) {
+  return impl_->Run(std::move(module));
+}
+
+}  // namespace frontend
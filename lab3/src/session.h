@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <experimental/propagate_const>
+#include <memory>
+#include <string_view>
+
+namespace llvm {
+class LLVMContext;
+class Module;
+class TargetMachine;
+}  // namespace llvm
+
+namespace frontend {
+
+// A module and the context it was created in. The module is declared last, so
+// that it's destroyed before its context.
+struct OwnedModule final {
+  std::unique_ptr<llvm::LLVMContext> context;
+  std::unique_ptr<llvm::Module> module;
+};
+
+// LLVM state that outlives a single compilation: the target machine and the
+// JIT. Creating them costs more than compiling a small program, so a
+// long-lived process keeps one session per thread and compiles every program
+// in it. Contexts aren't shared: every compilation creates its own, and the
+// types, constants, and metadata interned in it go away with its module, so a
+// session doesn't grow with the programs it compiles. A session must not be
+// used by two threads at once.
+class Session final {
+ public:
+  // Targets the generic CPU of the host architecture, the given CPU of the
+  // host architecture, or the host CPU and all of its features if the CPU is
+  // "native".
+  explicit Session(std::string_view target_cpu = {});
+  ~Session();
+
+  // Sets the target triple and data layout of the module, and the CPU and
+  // features of its functions if a CPU was given.
+  void Configure(llvm::Module& module);
+
+  llvm::TargetMachine& GetTargetMachine();
+  // Creates another target machine for the same target, for use by another
+  // thread.
+  std::unique_ptr<llvm::TargetMachine> CreateTargetMachine() const;
+
+  // Compiles the module in-process and returns the result of its main. The
+  // code is released afterwards, along with the module and its context, so
+  // the next module can define main again.
+  std::int64_t Run(OwnedModule module);
+
+ private:
+  class Impl;
+
+  std::experimental::propagate_const<std::unique_ptr<Impl>> impl_;
+};
+
+}  // namespace frontend
@@ -0,0 +1,29 @@
+# Writes OUTPUT, a header defining PARAPARACL_SOURCE_HASH as a SHA-256 of the
+# sources of the compiler in SOURCE_DIR, for the cache to key its entries on:
+#
+#   cmake -DSOURCE_DIR=<dir> -DOUTPUT=<header> -P source_hash.cmake
+#
+# The header is only rewritten when the hash changes, so that rebuilding
+# without a change to the sources doesn't recompile what includes it.
+
+file(GLOB sources RELATIVE ${SOURCE_DIR}
+  ${SOURCE_DIR}/*.cc ${SOURCE_DIR}/*.h ${SOURCE_DIR}/*.l ${SOURCE_DIR}/*.y
+)
+list(SORT sources)
+
+# Every file adds its name and its hash, so that renaming one changes the
+# hash as well.
+set(hashes "")
+foreach(source IN LISTS sources)
+  file(SHA256 ${SOURCE_DIR}/${source} hash)
+  string(APPEND hashes "${source} ${hash}\n")
+endforeach()
+string(SHA256 hash "${hashes}")
+
+set(contents "#pragma once\n\n#define PARAPARACL_SOURCE_HASH \"${hash}\"\n")
+if(EXISTS ${OUTPUT})
+  file(READ ${OUTPUT} previous)
+endif()
+if(NOT contents STREQUAL previous)
+  file(WRITE ${OUTPUT} "${contents}")
+endif()
@@ -0,0 +1,129 @@
+#include "statistics.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+// clang-format off
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+// clang-format on
+
+namespace frontend {
+
+namespace {
+
+struct PhaseName final {
+  std::string_view name;
+  std::string_view description;
+};
+
+constexpr PhaseName kPhaseNames[kPhaseCount] = {
+    {"scan", "Scanning"},
+    {"parse", "Parsing"},
+    {"analyze", "Resolving and folding"},
+    {"codegen", "Generating IR"},
+    {"verify", "Verifying IR"},
+    {"optimize", "Optimizing IR"},
+    {"emit", "Emitting output"},
+    {"run", "Running"},
+};
+static_assert(static_cast<std::size_t>(Phase::kRun) + 1 == kPhaseCount);
+
+struct CounterName final {
+  std::string_view name;
+  std::string_view description;
+  std::uint64_t Counters::*counter;
+};
+
+constexpr CounterName kCounterNames[] = {
+    {"tokens", "Tokens scanned", &Counters::tokens},
+    {"ast-nodes", "AST nodes created", &Counters::ast_nodes},
+    {"basic-blocks", "Basic blocks in the module", &Counters::basic_blocks},
+    {"instructions", "Instructions in the module", &Counters::instructions},
+    {"allocas", "Allocas in the module", &Counters::allocas},
+    {"bytes-emitted", "Bytes of output written", &Counters::bytes_emitted},
+    {"cache-hits", "Outputs found in the cache", &Counters::cache_hits},
+    {"cache-misses", "Outputs compiled and cached", &Counters::cache_misses},
+};
+
+llvm::StringRef ToStringRef(const std::string_view string) {
+  return {string.data(), string.size()};
+}
+
+}  // namespace
+
+Statistics::Statistics(const bool is_timing)
+    : is_timing_(is_timing),
+      timer_group_("paraparacl", "ParaParaCL compilation phases") {
+  for (auto i = std::size_t{0}; i < kPhaseCount; ++i) {
+    timers_[i].init(ToStringRef(kPhaseNames[i].name),
+                    ToStringRef(kPhaseNames[i].description), timer_group_);
+  }
+}
+
+// LLVM prints the timers that ran when they're destroyed unless they were
+// cleared, which would repeat the report or print one for a failed
+// compilation.
+Statistics::~Statistics() { timer_group_.clear(); }
+
+llvm::TimeRegion Statistics::Time(const Phase phase) {
+  return llvm::TimeRegion{
+      is_timing_ ? &timers_[static_cast<std::size_t>(phase)] : nullptr};
+}
+
+void Statistics::Print(llvm::raw_ostream& output, const ReportFormat format,
+                       const bool has_counters) {
+  if (format == ReportFormat::kText) {
+    if (is_timing_) {
+      timer_group_.print(output, /*ResetAfterPrint=*/true);
+    }
+    if (has_counters) {
+      output << "===" << std::string(73, '-') << "===\n"
+             << "                          ... Statistics Collected ...\n"
+             << "===" << std::string(73, '-') << "===\n\n";
+      for (const auto& [name, description, counter] : kCounterNames) {
+        output << llvm::format("%12llu %-13s - %s\n",
+                               static_cast<unsigned long long>(
+                                   counters_.*counter),
+                               name.data(), description.data());
+      }
+      output << "\n";
+    }
+    output.flush();
+    return;
+  }
+
+  auto report = llvm::json::Object{};
+  if (is_timing_) {
+    auto phases = llvm::json::Object{};
+    for (auto i = std::size_t{0}; i < kPhaseCount; ++i) {
+      if (!timers_[i].hasTriggered()) {
+        continue;
+      }
+      const auto time = timers_[i].getTotalTime();
+      phases[ToStringRef(kPhaseNames[i].name)] = llvm::json::Object{
+          {"wall", time.getWallTime()},
+          {"user", time.getUserTime()},
+          {"system", time.getSystemTime()},
+      };
+    }
+    report["phases"] = std::move(phases);
+    timer_group_.clear();
+  }
+  if (has_counters) {
+    auto counters = llvm::json::Object{};
+    for (const auto& [name, description, counter] : kCounterNames) {
+      counters[ToStringRef(name)] =
+          static_cast<std::int64_t>(counters_.*counter);
+    }
+    report["counters"] = std::move(counters);
+  }
+  output << llvm::formatv("{0:2}", llvm::json::Value(std::move(report)))
+         << "\n";
+  output.flush();
+}
+
+}  // namespace frontend
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// clang-format off
+#include "llvm/Support/Timer.h"
+// clang-format on
+
+namespace llvm {
+class raw_ostream;
+}  // namespace llvm
+
+namespace frontend {
+
+enum class Phase {
+  kScan,
+  kParse,
+  kAnalyze,
+  kCodegen,
+  kVerify,
+  kOptimize,
+  kEmit,
+  kRun,
+};
+
+inline constexpr std::size_t kPhaseCount = 8;
+
+enum class ReportFormat {
+  kText,
+  kJson,
+};
+
+// Sizes of what the phases produced. The module counters describe the module
+// as it was emitted or run, after optimization; on a cache hit nothing is
+// compiled and only the output is counted.
+struct Counters final {
+  std::uint64_t tokens = 0;
+  std::uint64_t ast_nodes = 0;
+  std::uint64_t basic_blocks = 0;
+  std::uint64_t instructions = 0;
+  std::uint64_t allocas = 0;
+  std::uint64_t bytes_emitted = 0;
+  std::uint64_t cache_hits = 0;
+  std::uint64_t cache_misses = 0;
+};
+
+// Times the phases of one compilation with LLVM timers and counts what they
+// produce, for --time-phases and --stats. Like the compilation itself, it must
+// not be used by two threads at once.
+class Statistics final {
+ public:
+  explicit Statistics(bool is_timing);
+  ~Statistics();
+
+  bool is_timing() const noexcept { return is_timing_; }
+
+  // Times the phase until the region is destroyed, if timing.
+  llvm::TimeRegion Time(Phase phase);
+
+  Counters& get_counters() noexcept { return counters_; }
+  const Counters& get_counters() const noexcept { return counters_; }
+
+  // Prints the phases that ran if timing, and the counters if asked to.
+  void Print(llvm::raw_ostream& output, ReportFormat format,
+             bool has_counters);
+
+ private:
+  bool is_timing_;
+  Counters counters_;
+  llvm::TimerGroup timer_group_;
+  // Destroyed before their group.
+  std::array<llvm::Timer, kPhaseCount> timers_;
+};
+
+// Times the phase if there are statistics to record it in.
+inline llvm::TimeRegion TimePhase(Statistics* const statistics,
+                                  const Phase phase) {
+  return statistics != nullptr ? statistics->Time(phase)
+                               : llvm::TimeRegion{nullptr};
+}
+
+}  // namespace frontend
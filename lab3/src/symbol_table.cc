@@ -0,0 +1,14 @@
+#include "symbol_table.h"
+
+namespace frontend {
+
+Symbol SymbolTable::Intern(const std::string_view name) {
+  const auto [it, is_inserted] =
+      symbols_.try_emplace(name, static_cast<Symbol>(names_.size()));
+  if (is_inserted) {
+    names_.push_back(name);
+  }
+  return it->second;
+}
+
+}  // namespace frontend
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace frontend {
+
+// Interned identifier: equal names map to equal symbols.
+using Symbol = std::uint32_t;
+
+// Storage index of a variable in the function being compiled, assigned by the
+// Resolver to every name reference.
+using Slot = std::uint32_t;
+
+inline constexpr Slot kUnresolvedSlot = std::numeric_limits<Slot>::max();
+
+// Index of a user-defined function, assigned by the Resolver in the order
+// functions are first mentioned, by a call or a definition.
+using FunctionIndex = std::uint32_t;
+
+inline constexpr FunctionIndex kUnresolvedFunction =
+    std::numeric_limits<FunctionIndex>::max();
+
+// Names aren't copied: the scanner interns views into the source buffer, which
+// the Driver keeps alive as long as the table.
+class SymbolTable final {
+ public:
+  Symbol Intern(std::string_view name);
+
+  std::string_view get_name(const Symbol symbol) const noexcept {
+    return names_[symbol];
+  }
+  std::size_t get_size() const noexcept { return names_.size(); }
+
+ private:
+  std::unordered_map<std::string_view, Symbol> symbols_;
+  std::vector<std::string_view> names_;
+};
+
+}  // namespace frontend
@@ -3,7 +3,10 @@
 namespace frontend {
 
 class Program;
+class FunctionDef;
 class AssignStmt;
+class StoreStmt;
+class ArrayDeclStmt;
 class IfStmt;
 class WhileStmt;
 class ReturnStmt;
@@ -11,6 +14,9 @@ class BinaryExpr;
 class UnaryExpr;
 class VarExpr;
 class NumberExpr;
+class CallExpr;
+class IndexExpr;
+class LengthExpr;
 
 class IVisitor {
  public:
@@ -18,7 +24,10 @@ class IVisitor {
 
  public:
   virtual void Visit(Program& program) = 0;
+  virtual void Visit(FunctionDef& def) = 0;
   virtual void Visit(AssignStmt& stmt) = 0;
+  virtual void Visit(StoreStmt& stmt) = 0;
+  virtual void Visit(ArrayDeclStmt& stmt) = 0;
   virtual void Visit(ReturnStmt& stmt) = 0;
   virtual void Visit(IfStmt& stmt) = 0;
   virtual void Visit(WhileStmt& stmt) = 0;
@@ -26,6 +35,9 @@ class IVisitor {
   virtual void Visit(UnaryExpr& expr) = 0;
   virtual void Visit(VarExpr& expr) = 0;
   virtual void Visit(NumberExpr& expr) = 0;
+  virtual void Visit(CallExpr& expr) = 0;
+  virtual void Visit(IndexExpr& expr) = 0;
+  virtual void Visit(LengthExpr& expr) = 0;
 };
 
 }  // namespace frontend
@@ -1,9 +1,13 @@
 #!/usr/bin/env python3
 
+import json
 import pathlib
+import shutil
+import socket
 import subprocess
 import sys
 import tempfile
+import time
 
 
 def compile_and_run(
@@ -12,9 +16,13 @@ def compile_and_run(
     lli: str,
     source: pathlib.Path,
     expected: int,
+    *options: str,
 ) -> None:
     result = subprocess.run(
-        [compiler, str(source)], check=True, capture_output=True, text=True
+        [compiler, *options, str(source)],
+        check=True,
+        capture_output=True,
+        text=True,
     )
     with tempfile.TemporaryDirectory() as directory:
         ir_path = pathlib.Path(directory) / "module.ll"
@@ -30,10 +38,481 @@ def compile_and_run(
                 f"{execution.returncode}"
             )
 
+        direct_path = pathlib.Path(directory) / "direct.bc"
+        subprocess.run(
+            [
+                compiler,
+                *options,
+                "--emit=bc",
+                "-o",
+                str(direct_path),
+                str(source),
+            ],
+            check=True,
+        )
+        execution = subprocess.run([lli, str(direct_path)], check=False)
+        if execution.returncode != expected:
+            raise RuntimeError(
+                f"{source.name}: expected --emit=bc exit {expected}, got "
+                f"{execution.returncode}"
+            )
+
+    in_process = subprocess.run(
+        [compiler, *options, "--run", str(source)], check=False
+    )
+    if in_process.returncode != expected:
+        raise RuntimeError(
+            f"{source.name}: expected --run exit {expected}, got "
+            f"{in_process.returncode}"
+        )
+
+    interpreted = subprocess.run(
+        [compiler, *options, "--interpret", str(source)], check=False
+    )
+    if interpreted.returncode != expected:
+        raise RuntimeError(
+            f"{source.name}: expected --interpret exit {expected}, got "
+            f"{interpreted.returncode}"
+        )
+
+
+def compile_native(
+    compiler: str, source: pathlib.Path, expected: int, *options: str
+) -> None:
+    with tempfile.TemporaryDirectory() as directory:
+        object_path = pathlib.Path(directory) / "module.o"
+        subprocess.run(
+            [
+                compiler,
+                *options,
+                "--emit=obj",
+                "-o",
+                str(object_path),
+                str(source),
+            ],
+            check=True,
+        )
+        linker = shutil.which("cc")
+        if linker is None:
+            return
+        executable_path = pathlib.Path(directory) / "module"
+        subprocess.run(
+            [linker, str(object_path), "-o", str(executable_path)], check=True
+        )
+        execution = subprocess.run([str(executable_path)], check=False)
+        if execution.returncode != expected:
+            raise RuntimeError(
+                f"{source.name}: expected native exit {expected}, got "
+                f"{execution.returncode}"
+            )
+
+
+def compile_batch(
+    compiler: str,
+    lli: str,
+    sources: dict[pathlib.Path, int],
+    failing: pathlib.Path,
+) -> None:
+    with tempfile.TemporaryDirectory() as directory:
+        inputs = []
+        for source in (*sources, failing):
+            copy = pathlib.Path(directory) / source.name
+            shutil.copyfile(source, copy)
+            inputs.append(copy)
+        response_path = pathlib.Path(directory) / "inputs.rsp"
+        response_path.write_text(
+            "\n".join(str(path) for path in inputs), encoding="utf-8"
+        )
+
+        result = subprocess.run(
+            [compiler, "--emit=bc", "--jobs=4", f"@{response_path}"],
+            check=False,
+            capture_output=True,
+            text=True,
+        )
+        if result.returncode == 0 or failing.name not in result.stderr:
+            raise RuntimeError(f"{failing.name}: batch error was not reported")
+        for source, expected in sources.items():
+            bitcode_path = pathlib.Path(directory) / f"{source.stem}.bc"
+            execution = subprocess.run([lli, str(bitcode_path)], check=False)
+            if execution.returncode != expected:
+                raise RuntimeError(
+                    f"{source.name}: expected batch exit {expected}, got "
+                    f"{execution.returncode}"
+                )
+
+        # The same file twice would be written by two jobs at once.
+        duplicated = subprocess.run(
+            [compiler, "--emit=bc", "--jobs=2", str(inputs[0]), str(inputs[0])],
+            check=False,
+            capture_output=True,
+            text=True,
+        )
+        if duplicated.returncode == 0 or "both" not in duplicated.stderr:
+            raise RuntimeError("batch: a duplicate output was not rejected")
+
+
+def frame_request(request_id: str, kind: str, source: bytes) -> bytes:
+    return f"{request_id} {kind} {len(source)}\n".encode() + source
+
+
+def parse_responses(data: bytes) -> dict[str, tuple[str, bytes]]:
+    responses = {}
+    while data:
+        header, data = data.split(b"\n", 1)
+        request_id, status, size = header.decode().split()
+        responses[request_id] = (status, data[: int(size)])
+        data = data[int(size) :]
+    return responses
+
+
+def check_server(
+    compiler: str,
+    fibonacci: pathlib.Path,
+    unknown_variable: pathlib.Path,
+    array_bounds: pathlib.Path,
+) -> None:
+    source = fibonacci.read_bytes()
+    # A program that traps or doesn't end is answered with an error, and the
+    # requests after it still are answered.
+    requests = b"".join(
+        (
+            frame_request("run", "run", source),
+            frame_request("ir", "ll", source),
+            frame_request("object", "obj", source),
+            frame_request("unknown", "run", unknown_variable.read_bytes()),
+            frame_request("syntax", "run", b"x = @;"),
+            frame_request("kind", "exe", source),
+            frame_request("bounds", "run", array_bounds.read_bytes()),
+            frame_request("forever", "run", b"while (0 == 0) {} return 0;"),
+            frame_request("again", "run", source),
+        )
+    )
+    result = subprocess.run(
+        [compiler, "--server", "--jobs=2", "-O2"],
+        input=requests,
+        check=True,
+        capture_output=True,
+    )
+    responses = parse_responses(result.stdout)
+    if (
+        responses.get("run") != ("ok", b"55")
+        or responses.get("again") != ("ok", b"55")
+        or responses.get("ir", ("",))[0] != "ok"
+        or b"define" not in responses["ir"][1]
+        or responses.get("object", ("",))[0] != "ok"
+        or responses.get("unknown", ("",))[0] != "error"
+        or responses.get("syntax", ("", b""))[1].split(b":")[0] != b"syntax"
+        or responses.get("kind", ("",))[0] != "error"
+        or responses.get("bounds", ("",))[0] != "error"
+        or responses.get("forever") != ("error", b"Program ran too long")
+    ):
+        raise RuntimeError(f"unexpected server responses: {responses}")
+
+    for request, message in (
+        (b"x" * 1000 + b" run 1\n", b"Request header is too long"),
+        (b"big run 99999999999\n", b"Request is too large"),
+        (b"size run 1x\n", b"Malformed request size"),
+        (b"run 1\n", b"Malformed request header"),
+        (b"truncated run", b"Truncated request header"),
+    ):
+        rejected = subprocess.run(
+            [compiler, "--server"],
+            input=request,
+            check=True,
+            capture_output=True,
+        )
+        if parse_responses(rejected.stdout).get("-") != ("error", message):
+            raise RuntimeError(f"unexpected rejection: {rejected.stdout!r}")
+
+    with tempfile.TemporaryDirectory() as directory:
+        socket_path = pathlib.Path(directory) / "server.sock"
+        server = subprocess.Popen([compiler, f"--server={socket_path}"])
+        try:
+            for _ in range(100):
+                if socket_path.exists():
+                    break
+                time.sleep(0.05)
+            with socket.socket(socket.AF_UNIX) as client:
+                client.connect(str(socket_path))
+                client.sendall(frame_request("socket", "run", source))
+                client.shutdown(socket.SHUT_WR)
+                data = b""
+                while chunk := client.recv(4096):
+                    data += chunk
+        finally:
+            server.terminate()
+            server.wait()
+        if parse_responses(data).get("socket") != ("ok", b"55"):
+            raise RuntimeError(f"unexpected socket response: {data!r}")
+
+
+def check_deep_expressions(compiler: str) -> None:
+    # Operator chains far deeper than the call stack could hold if a pass
+    # recursed once per operand.
+    terms = 100_000
+    chain = " + ".join(["a"] * terms)
+    nested = "(a - " * terms + "0" + ")" * terms
+    condition = " && ".join(["!!a"] * terms)
+    source = (
+        f"a = 1;\nb = {chain};\nc = {nested};\n"
+        f"if ({condition}) {{\n  return b + c;\n}} else {{\n  return 0;\n}}\n"
+    )
+    with tempfile.TemporaryDirectory() as directory:
+        path = pathlib.Path(directory) / "deep.dat"
+        path.write_text(source, encoding="utf-8")
+        for options in (
+            ("--run",),
+            ("--interpret",),
+            ("--interpret", "--short-circuit"),
+        ):
+            result = subprocess.run(
+                [compiler, *options, str(path)], check=False
+            )
+            if result.returncode != terms % 256:
+                raise RuntimeError(
+                    f"deep.dat: expected {' '.join(options)} exit "
+                    f"{terms % 256}, got {result.returncode}"
+                )
+        # With short-circuit evaluation the condition becomes a chain of as
+        # many blocks, which the backend would take long to compile.
+        subprocess.run(
+            [
+                compiler,
+                "--short-circuit",
+                "-o",
+                str(pathlib.Path(directory) / "deep.ll"),
+                str(path),
+            ],
+            check=True,
+        )
+
+
+def check_deep_recursion(compiler: str) -> None:
+    # Interpreter frames live on the heap, so recursion isn't bounded by the
+    # native stack.
+    depth = 1_000_000
+    source = (
+        "func depth(n) {\n  if (n == 0) {\n    return 0;\n  } else {\n"
+        "    return depth(n - 1) + 1;\n  }\n}\n\n"
+        f"return depth({depth});\n"
+    )
+    with tempfile.TemporaryDirectory() as directory:
+        path = pathlib.Path(directory) / "recursion.dat"
+        path.write_text(source, encoding="utf-8")
+        result = subprocess.run(
+            [compiler, "--interpret", str(path)], check=False
+        )
+        if result.returncode != depth % 256:
+            raise RuntimeError(
+                f"recursion.dat: expected --interpret exit {depth % 256}, "
+                f"got {result.returncode}"
+            )
+
+
+def check_streaming(
+    compiler: str, sources: list[pathlib.Path], failures: list[pathlib.Path]
+) -> None:
+    for source in sources:
+        for options in ((), ("--short-circuit",), ("-O2",)):
+            whole, streamed = (
+                subprocess.run(
+                    [compiler, *options, *stream, str(source)],
+                    check=True,
+                    capture_output=True,
+                    text=True,
+                ).stdout
+                for stream in ((), ("--stream",))
+            )
+            if streamed != whole:
+                raise RuntimeError(
+                    f"{source.name}: --stream {' '.join(options)} changed "
+                    "the module"
+                )
+    for source in failures:
+        expect_failure(compiler, source, "--stream")
+
+    # The arena holds one top-level statement at a time, so it stays within
+    # its first slab however many statements the file has.
+    statements = 20_000
+    lines = ["a = 0;"]
+    for _ in range(statements):
+        lines.append("if (a > -1) { a = a + 1; } else { a = a - 1; }")
+    lines.append("return a;")
+    with tempfile.TemporaryDirectory() as directory:
+        path = pathlib.Path(directory) / "long.dat"
+        path.write_text("\n".join(lines), encoding="utf-8")
+        result = subprocess.run(
+            [compiler, "--stream", "--memory-report", "--run", str(path)],
+            check=False,
+            capture_output=True,
+            text=True,
+        )
+        if result.returncode != statements % 256:
+            raise RuntimeError(
+                f"long.dat: expected --stream --run exit "
+                f"{statements % 256}, got {result.returncode}"
+            )
+        used = int(result.stderr.split("AST arena: ")[1].split()[0])
+        if used > 4096:
+            raise RuntimeError(f"long.dat: streamed arena used {used} bytes")
+
+
+def check_cache(compiler: str, source: pathlib.Path) -> None:
+    def compile_cached(
+        cache: pathlib.Path, path: pathlib.Path, *options: str
+    ) -> tuple[bytes, dict[str, int]]:
+        result = subprocess.run(
+            [
+                compiler,
+                f"--cache-dir={cache}",
+                "--stats",
+                "--report-format=json",
+                *options,
+                str(path),
+            ],
+            check=True,
+            capture_output=True,
+        )
+        return result.stdout, json.loads(result.stderr)["counters"]
+
+    uncached = subprocess.run(
+        [compiler, "-O2", str(source)], check=True, capture_output=True
+    ).stdout
+    with tempfile.TemporaryDirectory() as directory:
+        cache = pathlib.Path(directory) / "cache"
+        for options, expected in (
+            (("-O2",), "cache-misses"),
+            (("-O2",), "cache-hits"),
+            (("-O1",), "cache-misses"),
+            (("-O2", "--short-circuit"), "cache-misses"),
+            (("-O2", "--emit=bc", "-o", "-"), "cache-misses"),
+        ):
+            output, counters = compile_cached(cache, source, *options)
+            if counters[expected] != 1:
+                raise RuntimeError(
+                    f"{source.name}: expected a {expected[:-1]} with "
+                    f"{' '.join(options)}, got {counters}"
+                )
+            if options == ("-O2",) and output != uncached:
+                raise RuntimeError(f"{source.name}: cached output differs")
+
+        # Every output is larger than a tenth of the limit, so the cache
+        # evicts the oldest ones to stay within it.
+        body = "a = a * 3 + a / 7 + i;\n" * 600
+        paths = []
+        for i in range(30):
+            path = pathlib.Path(directory) / f"large{i}.dat"
+            path.write_text(
+                f"a = {i};\ni = 0;\nwhile (i < 3) {{\n{body}"
+                "i = i + 1;\n}\nreturn a;\n",
+                encoding="utf-8",
+            )
+            paths.append(path)
+        subprocess.run(
+            [
+                compiler,
+                f"--cache-dir={cache}",
+                "--cache-size=1",
+                "--jobs=1",
+                *map(str, paths),
+            ],
+            check=True,
+        )
+        size = sum(entry.stat().st_size for entry in cache.iterdir())
+        if size > 1 << 20:
+            raise RuntimeError(f"cache grew to {size} bytes past its limit")
+        if compile_cached(cache, paths[-1])[1]["cache-hits"] != 1:
+            raise RuntimeError("the most recent output was evicted")
+        if compile_cached(cache, paths[0])[1]["cache-misses"] != 1:
+            raise RuntimeError("the oldest output was not evicted")
+
+
+def check_profile(compiler: str, source: pathlib.Path, expected: int) -> None:
+    with tempfile.TemporaryDirectory() as directory:
+        profile = pathlib.Path(directory) / "program.profile"
+        for options in (("--run",), ("-O2", "--run")):
+            instrumented = subprocess.run(
+                [compiler, *options, f"--instrument={profile}", str(source)],
+                check=False,
+            )
+            if instrumented.returncode != expected:
+                raise RuntimeError(
+                    f"{source.name}: expected instrumented exit {expected}, "
+                    f"got {instrumented.returncode}"
+                )
+            # fib(10) is entered 177 times and returns n 89 times.
+            lines = profile.read_text(encoding="utf-8").splitlines()
+            if "fib 177 89 88" not in lines:
+                raise RuntimeError(f"{source.name}: unexpected profile {lines}")
+
+        optimized = subprocess.run(
+            [compiler, f"--profile-use={profile}", str(source)],
+            check=True,
+            capture_output=True,
+            text=True,
+        )
+        if (
+            '!"function_entry_count", i64 177' not in optimized.stdout
+            or '!"branch_weights", i32 90, i32 89' not in optimized.stdout
+        ):
+            raise RuntimeError(f"{source.name}: profile counts were not used")
+
+        profile.write_text("fib 1 2\n", encoding="utf-8")
+        expect_failure(compiler, source, f"--profile-use={profile}")
 
-def expect_failure(compiler: str, source: pathlib.Path) -> None:
+
+def check_loop_profile(compiler: str, source: pathlib.Path) -> None:
+    with tempfile.TemporaryDirectory() as directory:
+        profile = pathlib.Path(directory) / "program.profile"
+        subprocess.run(
+            [compiler, "--run", f"--instrument={profile}", str(source)],
+            check=False,
+        )
+        optimized = subprocess.run(
+            [compiler, f"--profile-use={profile}", str(source)],
+            check=True,
+            capture_output=True,
+            text=True,
+        )
+        # The inner guard enters 4 times and skips once; its latch branches
+        # back 6 times and leaves 4. Weights are the counts plus one.
+        if (
+            '!"branch_weights", i32 5, i32 2' not in optimized.stdout
+            or '!"branch_weights", i32 7, i32 5' not in optimized.stdout
+        ):
+            raise RuntimeError(
+                f"{source.name}: guard and latch weights were not apart"
+            )
+
+
+def check_reserved_names(compiler: str, source: pathlib.Path) -> None:
+    # The profile writer calls fopen, fprintf, and fclose, which the program
+    # defines as functions of its own.
+    with tempfile.TemporaryDirectory() as directory:
+        profile = pathlib.Path(directory) / "program.profile"
+        instrumented = subprocess.run(
+            [compiler, "--run", f"--instrument={profile}", str(source)],
+            check=False,
+        )
+        if instrumented.returncode != 28:
+            raise RuntimeError(
+                f"{source.name}: expected instrumented exit 28, "
+                f"got {instrumented.returncode}"
+            )
+        lines = profile.read_text(encoding="utf-8").splitlines()
+        if "fopen 1" not in lines:
+            raise RuntimeError(f"{source.name}: unexpected profile {lines}")
+
+
+def expect_failure(
+    compiler: str, source: pathlib.Path, *options: str
+) -> None:
     result = subprocess.run(
-        [compiler, str(source)], check=False, capture_output=True, text=True
+        [compiler, *options, str(source)],
+        check=False,
+        capture_output=True,
+        text=True,
     )
     if result.returncode == 0:
         raise RuntimeError(f"{source.name}: compilation unexpectedly succeeded")
@@ -43,25 +522,263 @@ def main() -> int:
     compiler, llvm_as, lli, fibonacci_path, cases_path = sys.argv[1:]
     cases = pathlib.Path(cases_path)
 
+    fibonacci = pathlib.Path(fibonacci_path)
+    for options in (
+        (),
+        ("-O2",),
+        ("--passes=sroa,instcombine,gvn",),
+        ("--short-circuit",),
+    ):
+        compile_and_run(compiler, llvm_as, lli, fibonacci, 55, *options)
+        for name, expected in (
+            ("modulo.dat", 1),
+            ("unary.dat", 6),
+            ("comparison-value.dat", 1),
+            ("nested-scope.dat", 5),
+            ("return-in-branch.dat", 7),
+            ("nested-loop.dat", 42),
+            ("constant-folding.dat", 14),
+            ("logical.dat", 238),
+            ("functions.dat", 73),
+            ("arrays.dat", 74),
+            ("loop-hints.dat", 62),
+            ("reserved-names.dat", 28),
+        ):
+            compile_and_run(
+                compiler, llvm_as, lli, cases / name, expected, *options
+            )
+        compile_and_run(
+            compiler,
+            llvm_as,
+            lli,
+            cases / "ranges.dat",
+            46,
+            *options,
+            "--check-division",
+        )
+
     compile_and_run(
-        compiler, llvm_as, lli, pathlib.Path(fibonacci_path), expected=55
-    )
-    for name, expected in (
-        ("modulo.dat", 1),
-        ("unary.dat", 6),
-        ("comparison-value.dat", 1),
-        ("nested-scope.dat", 5),
-        ("return-in-branch.dat", 7),
+        compiler,
+        llvm_as,
+        lli,
+        cases / "short-circuit.dat",
+        2,
+        "--short-circuit",
+    )
+
+    compile_native(compiler, fibonacci, 55)
+    compile_native(
+        compiler, cases / "nested-loop.dat", 42, "-O2", "-mcpu=native"
+    )
+    assembly = subprocess.run(
+        [compiler, "--emit=asm", str(fibonacci)],
+        check=True,
+        capture_output=True,
+        text=True,
+    )
+    if "main" not in assembly.stdout:
+        raise RuntimeError(f"{fibonacci.name}: assembly does not define main")
+    in_process = subprocess.run(
+        [compiler, "-mcpu=native", "--run", str(fibonacci)], check=False
+    )
+    if in_process.returncode != 55:
+        raise RuntimeError(
+            f"{fibonacci.name}: expected -mcpu=native --run exit 55, got "
+            f"{in_process.returncode}"
+        )
+
+    compile_batch(
+        compiler,
+        lli,
+        {
+            fibonacci: 55,
+            cases / "modulo.dat": 1,
+            cases / "nested-scope.dat": 5,
+            cases / "nested-loop.dat": 42,
+        },
+        cases / "unknown-variable.dat",
+    )
+
+    check_server(
+        compiler,
+        fibonacci,
+        cases / "unknown-variable.dat",
+        cases / "array-bounds.dat",
+    )
+    check_deep_expressions(compiler)
+    check_deep_recursion(compiler)
+    check_cache(compiler, fibonacci)
+    check_profile(compiler, cases / "functions.dat", 73)
+    check_loop_profile(compiler, cases / "loop-profile.dat")
+    check_reserved_names(compiler, cases / "reserved-names.dat")
+    check_streaming(
+        compiler,
+        [
+            fibonacci,
+            cases / "constant-folding.dat",
+            cases / "nested-scope.dat",
+            cases / "return-in-branch.dat",
+            cases / "short-circuit.dat",
+            cases / "functions.dat",
+            cases / "arrays.dat",
+        ],
+        [
+            cases / "unknown-variable.dat",
+            cases / "fallthrough.dat",
+            cases / "unknown-function.dat",
+        ],
+    )
+
+    unoptimized = subprocess.run(
+        [compiler, str(fibonacci)], check=True, capture_output=True, text=True
+    )
+    if "alloca" in unoptimized.stdout or "phi" not in unoptimized.stdout:
+        raise RuntimeError(
+            f"{fibonacci.name}: variables were not lowered to SSA form"
+        )
+    if "zext" in unoptimized.stdout:
+        raise RuntimeError(
+            f"{fibonacci.name}: loop condition was widened before branching"
+        )
+    if "label %do, label %cont, !llvm.loop" not in unoptimized.stdout:
+        raise RuntimeError(f"{fibonacci.name}: loop was not rotated")
+
+    folded = subprocess.run(
+        [compiler, str(cases / "constant-folding.dat")],
+        check=True,
+        capture_output=True,
+        text=True,
+    )
+    if " br " in folded.stdout or "sdiv" in folded.stdout:
+        raise RuntimeError(
+            "constant-folding.dat: constant conditions were not folded"
+        )
+
+    ranged = subprocess.run(
+        [compiler, "--check-division", str(cases / "ranges.dat")],
+        check=True,
+        capture_output=True,
+        text=True,
+    )
+    for flagged in ("add nsw i64 %i, 1", "sdiv exact i64"):
+        if flagged not in ranged.stdout:
+            raise RuntimeError(f"ranges.dat: {flagged} is missing")
+    if "call void @llvm.trap()" in ranged.stdout:
+        raise RuntimeError("ranges.dat: checks that can't fail were kept")
+    for options, expected in (((), False), (("--check-division",), True)):
+        divided = subprocess.run(
+            [compiler, *options, str(cases / "division-by-zero.dat")],
+            check=True,
+            capture_output=True,
+            text=True,
+        )
+        if ("call void @llvm.trap()" in divided.stdout) != expected:
+            raise RuntimeError(
+                f"division-by-zero.dat: {options}: division checks were"
+                f" {'left out' if expected else 'emitted'}"
+            )
+
+    vectorized = subprocess.run(
+        [compiler, "-O2", str(cases / "arrays.dat")],
+        check=True,
+        capture_output=True,
+        text=True,
+    )
+    if "x i64>" not in vectorized.stdout:
+        raise RuntimeError("arrays.dat: loops over arrays were not vectorized")
+
+    hinted = subprocess.run(
+        [compiler, str(cases / "loop-hints.dat")],
+        check=True,
+        capture_output=True,
+        text=True,
+    )
+    for hint in (
+        '!"llvm.loop.unroll.count", i32 4',
+        '!"llvm.loop.unroll.disable"',
+        '!"llvm.loop.vectorize.enable", i1 true',
+        '!"llvm.loop.vectorize.width", i32 4',
     ):
-        compile_and_run(compiler, llvm_as, lli, cases / name, expected)
+        if hint not in hinted.stdout:
+            raise RuntimeError(f"loop-hints.dat: {hint} is missing")
+    forced = subprocess.run(
+        [compiler, "-O2", "--no-vectorize", str(cases / "loop-hints.dat")],
+        check=True,
+        capture_output=True,
+        text=True,
+    )
+    if "<4 x i64>" not in forced.stdout:
+        raise RuntimeError("loop-hints.dat: #vectorize(4) was not honored")
+
+    report = subprocess.run(
+        [
+            compiler,
+            "--time-phases",
+            "--stats",
+            "--report-format=json",
+            "--emit=bc",
+            "-o",
+            "-",
+            str(fibonacci),
+        ],
+        check=True,
+        capture_output=True,
+    )
+    statistics = json.loads(report.stderr)
+    counters = statistics["counters"]
+    if (
+        counters["tokens"] == 0
+        or counters["ast-nodes"] == 0
+        or counters["basic-blocks"] == 0
+        or counters["bytes-emitted"] != len(report.stdout)
+    ):
+        raise RuntimeError(f"{fibonacci.name}: unexpected counters {counters}")
+    if not {"scan", "parse", "codegen", "verify", "emit"} <= set(
+        statistics["phases"]
+    ):
+        raise RuntimeError(
+            f"{fibonacci.name}: phases missing from {statistics['phases']}"
+        )
 
     for name in (
         "unknown-variable.dat",
         "invalid-character.dat",
         "fallthrough.dat",
+        "scope-leak.dat",
+        "number-out-of-range.dat",
+        "unknown-function.dat",
+        "call-arity.dat",
+        "function-fallthrough.dat",
+        "function-scope.dat",
+        "array-as-number.dat",
+        "not-an-array.dat",
+        "loop-hint-range.dat",
+        "duplicate-loop-hint.dat",
+        "trailing-loop-hint.dat",
     ):
         expect_failure(compiler, cases / name)
     expect_failure(compiler, cases / "does-not-exist.dat")
+    expect_failure(compiler, cases / "unknown-variable.dat", "--run")
+    expect_failure(compiler, cases / "division-by-zero.dat", "--interpret")
+    expect_failure(
+        compiler, cases / "division-by-zero.dat", "--run", "--check-division"
+    )
+    expect_failure(compiler, cases / "array-bounds.dat", "--interpret")
+    expect_failure(compiler, cases / "array-bounds.dat", "--run")
+    expect_failure(compiler, fibonacci, "--passes=no-such-pass")
+    expect_failure(compiler, fibonacci, "--emit=exe")
+    expect_failure(compiler, fibonacci, "--run", "--emit=bc")
+    expect_failure(compiler, fibonacci, "-mcpu=no-such-cpu", "--emit=obj")
+    expect_failure(compiler, fibonacci, fibonacci, "--run")
+    expect_failure(compiler, fibonacci, "--run", "--interpret")
+    expect_failure(compiler, fibonacci, "--instrument", "--interpret")
+    expect_failure(compiler, fibonacci, "--profile-use=does-not-exist")
+    expect_failure(compiler, fibonacci, "--interpret", "-o", "-")
+    expect_failure(compiler, fibonacci, fibonacci, "-o", "-")
+    expect_failure(compiler, fibonacci, "--jobs=0")
+    expect_failure(compiler, fibonacci, fibonacci, "--stats")
+    expect_failure(compiler, fibonacci, "--stats", "--report-format=xml")
+    expect_failure(compiler, fibonacci, "--server")
     return 0
 
 